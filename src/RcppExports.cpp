@@ -1,11 +1,65 @@
 // Generated by using Rcpp::compileAttributes() -> do not edit by hand
 // Generator token: 10BE3573-1514-4C36-9D1C-5A225CD40393
 
-#include <RcppArmadillo.h>
+#include <RcppEigen.h>
 #include <Rcpp.h>
 
 using namespace Rcpp;
 
+// rcpp_save_graph
+void rcpp_save_graph(Rcpp::DataFrame compact, Rcpp::DataFrame original, Rcpp::DataFrame map, std::vector <std::string> weight_names, std::string filename);
+RcppExport SEXP _osmprob_rcpp_save_graph(SEXP compactSEXP, SEXP originalSEXP, SEXP mapSEXP, SEXP weight_namesSEXP, SEXP filenameSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::DataFrame >::type compact(compactSEXP);
+    Rcpp::traits::input_parameter< Rcpp::DataFrame >::type original(originalSEXP);
+    Rcpp::traits::input_parameter< Rcpp::DataFrame >::type map(mapSEXP);
+    Rcpp::traits::input_parameter< std::vector <std::string> >::type weight_names(weight_namesSEXP);
+    Rcpp::traits::input_parameter< std::string >::type filename(filenameSEXP);
+    rcpp_save_graph(compact, original, map, weight_names, filename);
+    return R_NilValue;
+END_RCPP
+}
+// rcpp_load_graph
+Rcpp::List rcpp_load_graph(std::string filename);
+RcppExport SEXP _osmprob_rcpp_load_graph(SEXP filenameSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type filename(filenameSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_load_graph(filename));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_expand_path
+Rcpp::IntegerVector rcpp_expand_path(Rcpp::DataFrame compact, std::vector <double> original_edge_id, std::vector <double> map_compact, std::vector <double> map_original, std::vector <std::string> path);
+RcppExport SEXP _osmprob_rcpp_expand_path(SEXP compactSEXP, SEXP original_edge_idSEXP, SEXP map_compactSEXP, SEXP map_originalSEXP, SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::DataFrame >::type compact(compactSEXP);
+    Rcpp::traits::input_parameter< std::vector <double> >::type original_edge_id(original_edge_idSEXP);
+    Rcpp::traits::input_parameter< std::vector <double> >::type map_compact(map_compactSEXP);
+    Rcpp::traits::input_parameter< std::vector <double> >::type map_original(map_originalSEXP);
+    Rcpp::traits::input_parameter< std::vector <std::string> >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_expand_path(compact, original_edge_id, map_compact, map_original, path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_original_to_compact
+Rcpp::IntegerVector rcpp_original_to_compact(std::vector <double> compact_edge_id, std::vector <double> original_edge_id, std::vector <double> map_compact, std::vector <double> map_original);
+RcppExport SEXP _osmprob_rcpp_original_to_compact(SEXP compact_edge_idSEXP, SEXP original_edge_idSEXP, SEXP map_compactSEXP, SEXP map_originalSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::vector <double> >::type compact_edge_id(compact_edge_idSEXP);
+    Rcpp::traits::input_parameter< std::vector <double> >::type original_edge_id(original_edge_idSEXP);
+    Rcpp::traits::input_parameter< std::vector <double> >::type map_compact(map_compactSEXP);
+    Rcpp::traits::input_parameter< std::vector <double> >::type map_original(map_originalSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_original_to_compact(compact_edge_id, original_edge_id, map_compact, map_original));
+    return rcpp_result_gen;
+END_RCPP
+}
 // rcpp_make_compact_graph
 Rcpp::List rcpp_make_compact_graph(Rcpp::DataFrame graph, bool quiet);
 RcppExport SEXP _osmprob_rcpp_make_compact_graph(SEXP graphSEXP, SEXP quietSEXP) {
@@ -18,15 +72,104 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// rcpp_set_instrumentation
+bool rcpp_set_instrumentation(bool on);
+RcppExport SEXP _osmprob_rcpp_set_instrumentation(SEXP onSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< bool >::type on(onSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_set_instrumentation(on));
+    return rcpp_result_gen;
+END_RCPP
+}
 // rcpp_lines_as_network
-Rcpp::List rcpp_lines_as_network(const Rcpp::List& sf_lines, Rcpp::DataFrame pr);
-RcppExport SEXP _osmprob_rcpp_lines_as_network(SEXP sf_linesSEXP, SEXP prSEXP) {
+Rcpp::List rcpp_lines_as_network(const Rcpp::List& sf_lines, Rcpp::DataFrame pr, bool equirectangular);
+RcppExport SEXP _osmprob_rcpp_lines_as_network(SEXP sf_linesSEXP, SEXP prSEXP, SEXP equirectangularSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< const Rcpp::List& >::type sf_lines(sf_linesSEXP);
     Rcpp::traits::input_parameter< Rcpp::DataFrame >::type pr(prSEXP);
-    rcpp_result_gen = Rcpp::wrap(rcpp_lines_as_network(sf_lines, pr));
+    Rcpp::traits::input_parameter< bool >::type equirectangular(equirectangularSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_lines_as_network(sf_lines, pr, equirectangular));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_read_osm
+Rcpp::List rcpp_read_osm(std::string filename, Rcpp::DataFrame pr);
+RcppExport SEXP _osmprob_rcpp_read_osm(SEXP filenameSEXP, SEXP prSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type filename(filenameSEXP);
+    Rcpp::traits::input_parameter< Rcpp::DataFrame >::type pr(prSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_read_osm(filename, pr));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_set_num_threads
+int rcpp_set_num_threads(int n);
+RcppExport SEXP _osmprob_rcpp_set_num_threads(SEXP nSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< int >::type n(nSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_set_num_threads(n));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_router_dijkstra_batch
+Rcpp::List rcpp_router_dijkstra_batch(Rcpp::DataFrame netdf, std::vector <long long> start_nodes, std::vector <long long> end_nodes, std::string method);
+RcppExport SEXP _osmprob_rcpp_router_dijkstra_batch(SEXP netdfSEXP, SEXP start_nodesSEXP, SEXP end_nodesSEXP, SEXP methodSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::DataFrame >::type netdf(netdfSEXP);
+    Rcpp::traits::input_parameter< std::vector <long long> >::type start_nodes(start_nodesSEXP);
+    Rcpp::traits::input_parameter< std::vector <long long> >::type end_nodes(end_nodesSEXP);
+    Rcpp::traits::input_parameter< std::string >::type method(methodSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_router_dijkstra_batch(netdf, start_nodes, end_nodes, method));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_distance_matrix
+Rcpp::NumericMatrix rcpp_distance_matrix(Rcpp::DataFrame netdf, std::vector <std::string> from_nodes, std::vector <std::string> to_nodes);
+RcppExport SEXP _osmprob_rcpp_distance_matrix(SEXP netdfSEXP, SEXP from_nodesSEXP, SEXP to_nodesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::DataFrame >::type netdf(netdfSEXP);
+    Rcpp::traits::input_parameter< std::vector <std::string> >::type from_nodes(from_nodesSEXP);
+    Rcpp::traits::input_parameter< std::vector <std::string> >::type to_nodes(to_nodesSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_distance_matrix(netdf, from_nodes, to_nodes));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_ch_build
+SEXP rcpp_ch_build(Rcpp::DataFrame netdf, std::vector <double> original_edge_id, std::vector <double> map_compact, std::vector <double> map_original);
+RcppExport SEXP _osmprob_rcpp_ch_build(SEXP netdfSEXP, SEXP original_edge_idSEXP, SEXP map_compactSEXP, SEXP map_originalSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::DataFrame >::type netdf(netdfSEXP);
+    Rcpp::traits::input_parameter< std::vector <double> >::type original_edge_id(original_edge_idSEXP);
+    Rcpp::traits::input_parameter< std::vector <double> >::type map_compact(map_compactSEXP);
+    Rcpp::traits::input_parameter< std::vector <double> >::type map_original(map_originalSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_ch_build(netdf, original_edge_id, map_compact, map_original));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_ch_query
+Rcpp::NumericVector rcpp_ch_query(SEXP ch, std::string start_node, std::string end_node);
+RcppExport SEXP _osmprob_rcpp_ch_query(SEXP chSEXP, SEXP start_nodeSEXP, SEXP end_nodeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type ch(chSEXP);
+    Rcpp::traits::input_parameter< std::string >::type start_node(start_nodeSEXP);
+    Rcpp::traits::input_parameter< std::string >::type end_node(end_nodeSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_ch_query(ch, start_node, end_node));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -45,8 +188,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // rcpp_router_prob
-Rcpp::NumericVector rcpp_router_prob(Rcpp::DataFrame netdf, long long start_node, long long end_node, double eta);
-RcppExport SEXP _osmprob_rcpp_router_prob(SEXP netdfSEXP, SEXP start_nodeSEXP, SEXP end_nodeSEXP, SEXP etaSEXP) {
+Rcpp::NumericVector rcpp_router_prob(Rcpp::DataFrame netdf, long long start_node, long long end_node, double eta, std::string method, double tol, int max_iter);
+RcppExport SEXP _osmprob_rcpp_router_prob(SEXP netdfSEXP, SEXP start_nodeSEXP, SEXP end_nodeSEXP, SEXP etaSEXP, SEXP methodSEXP, SEXP tolSEXP, SEXP max_iterSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -54,20 +197,193 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< long long >::type start_node(start_nodeSEXP);
     Rcpp::traits::input_parameter< long long >::type end_node(end_nodeSEXP);
     Rcpp::traits::input_parameter< double >::type eta(etaSEXP);
-    rcpp_result_gen = Rcpp::wrap(rcpp_router_prob(netdf, start_node, end_node, eta));
+    Rcpp::traits::input_parameter< std::string >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< int >::type max_iter(max_iterSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_router_prob(netdf, start_node, end_node, eta, method, tol, max_iter));
     return rcpp_result_gen;
 END_RCPP
 }
 // rcpp_router_dijkstra
-Rcpp::NumericVector rcpp_router_dijkstra(Rcpp::DataFrame netdf, int start_node, int end_node);
-RcppExport SEXP _osmprob_rcpp_router_dijkstra(SEXP netdfSEXP, SEXP start_nodeSEXP, SEXP end_nodeSEXP) {
+Rcpp::NumericVector rcpp_router_dijkstra(Rcpp::DataFrame netdf, int start_node, int end_node, std::string method);
+RcppExport SEXP _osmprob_rcpp_router_dijkstra(SEXP netdfSEXP, SEXP start_nodeSEXP, SEXP end_nodeSEXP, SEXP methodSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< Rcpp::DataFrame >::type netdf(netdfSEXP);
     Rcpp::traits::input_parameter< int >::type start_node(start_nodeSEXP);
     Rcpp::traits::input_parameter< int >::type end_node(end_nodeSEXP);
-    rcpp_result_gen = Rcpp::wrap(rcpp_router_dijkstra(netdf, start_node, end_node));
+    Rcpp::traits::input_parameter< std::string >::type method(methodSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_router_dijkstra(netdf, start_node, end_node, method));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_prepare_graph
+SEXP rcpp_prepare_graph(Rcpp::DataFrame netdf, std::vector <double> original_edge_id, std::vector <double> map_compact, std::vector <double> map_original);
+RcppExport SEXP _osmprob_rcpp_prepare_graph(SEXP netdfSEXP, SEXP original_edge_idSEXP, SEXP map_compactSEXP, SEXP map_originalSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::DataFrame >::type netdf(netdfSEXP);
+    Rcpp::traits::input_parameter< std::vector <double> >::type original_edge_id(original_edge_idSEXP);
+    Rcpp::traits::input_parameter< std::vector <double> >::type map_compact(map_compactSEXP);
+    Rcpp::traits::input_parameter< std::vector <double> >::type map_original(map_originalSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_prepare_graph(netdf, original_edge_id, map_compact, map_original));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_prepared_path
+Rcpp::CharacterVector rcpp_prepared_path(SEXP pg, std::string start_node, std::string end_node, std::string method);
+RcppExport SEXP _osmprob_rcpp_prepared_path(SEXP pgSEXP, SEXP start_nodeSEXP, SEXP end_nodeSEXP, SEXP methodSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type pg(pgSEXP);
+    Rcpp::traits::input_parameter< std::string >::type start_node(start_nodeSEXP);
+    Rcpp::traits::input_parameter< std::string >::type end_node(end_nodeSEXP);
+    Rcpp::traits::input_parameter< std::string >::type method(methodSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_prepared_path(pg, start_node, end_node, method));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_prepared_paths
+Rcpp::List rcpp_prepared_paths(SEXP pg, std::vector <std::string> start_nodes, std::vector <std::string> end_nodes, std::string method);
+RcppExport SEXP _osmprob_rcpp_prepared_paths(SEXP pgSEXP, SEXP start_nodesSEXP, SEXP end_nodesSEXP, SEXP methodSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type pg(pgSEXP);
+    Rcpp::traits::input_parameter< std::vector <std::string> >::type start_nodes(start_nodesSEXP);
+    Rcpp::traits::input_parameter< std::vector <std::string> >::type end_nodes(end_nodesSEXP);
+    Rcpp::traits::input_parameter< std::string >::type method(methodSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_prepared_paths(pg, start_nodes, end_nodes, method));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_prepared_rsp
+Rcpp::List rcpp_prepared_rsp(SEXP pg, std::string start_node, std::string end_node, double eta, std::string solver, double tol);
+RcppExport SEXP _osmprob_rcpp_prepared_rsp(SEXP pgSEXP, SEXP start_nodeSEXP, SEXP end_nodeSEXP, SEXP etaSEXP, SEXP solverSEXP, SEXP tolSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type pg(pgSEXP);
+    Rcpp::traits::input_parameter< std::string >::type start_node(start_nodeSEXP);
+    Rcpp::traits::input_parameter< std::string >::type end_node(end_nodeSEXP);
+    Rcpp::traits::input_parameter< double >::type eta(etaSEXP);
+    Rcpp::traits::input_parameter< std::string >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< double >::type tol(tolSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_prepared_rsp(pg, start_node, end_node, eta, solver, tol));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_prepared_expand_path
+Rcpp::IntegerVector rcpp_prepared_expand_path(SEXP pg, std::vector <std::string> path);
+RcppExport SEXP _osmprob_rcpp_prepared_expand_path(SEXP pgSEXP, SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type pg(pgSEXP);
+    Rcpp::traits::input_parameter< std::vector <std::string> >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_prepared_expand_path(pg, path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_prepared_original_to_compact
+Rcpp::IntegerVector rcpp_prepared_original_to_compact(SEXP pg);
+RcppExport SEXP _osmprob_rcpp_prepared_original_to_compact(SEXP pgSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type pg(pgSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_prepared_original_to_compact(pg));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_router_rsp
+Rcpp::List rcpp_router_rsp(Rcpp::DataFrame netdf, std::string start_node, std::string end_node, double eta, std::string solver, double tol, Rcpp::Nullable <Rcpp::List> guess);
+RcppExport SEXP _osmprob_rcpp_router_rsp(SEXP netdfSEXP, SEXP start_nodeSEXP, SEXP end_nodeSEXP, SEXP etaSEXP, SEXP solverSEXP, SEXP tolSEXP, SEXP guessSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::DataFrame >::type netdf(netdfSEXP);
+    Rcpp::traits::input_parameter< std::string >::type start_node(start_nodeSEXP);
+    Rcpp::traits::input_parameter< std::string >::type end_node(end_nodeSEXP);
+    Rcpp::traits::input_parameter< double >::type eta(etaSEXP);
+    Rcpp::traits::input_parameter< std::string >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< Rcpp::Nullable <Rcpp::List> >::type guess(guessSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_router_rsp(netdf, start_node, end_node, eta, solver, tol, guess));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_router_rsp_eta
+Rcpp::List rcpp_router_rsp_eta(Rcpp::DataFrame netdf, std::string start_node, std::string end_node, std::vector <double> eta, std::string solver, double tol);
+RcppExport SEXP _osmprob_rcpp_router_rsp_eta(SEXP netdfSEXP, SEXP start_nodeSEXP, SEXP end_nodeSEXP, SEXP etaSEXP, SEXP solverSEXP, SEXP tolSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::DataFrame >::type netdf(netdfSEXP);
+    Rcpp::traits::input_parameter< std::string >::type start_node(start_nodeSEXP);
+    Rcpp::traits::input_parameter< std::string >::type end_node(end_nodeSEXP);
+    Rcpp::traits::input_parameter< std::vector <double> >::type eta(etaSEXP);
+    Rcpp::traits::input_parameter< std::string >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< double >::type tol(tolSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_router_rsp_eta(netdf, start_node, end_node, eta, solver, tol));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_router_rsp_od
+Rcpp::List rcpp_router_rsp_od(Rcpp::DataFrame netdf, std::vector <std::string> start_nodes, std::vector <std::string> end_nodes, double eta, std::string solver, double tol);
+RcppExport SEXP _osmprob_rcpp_router_rsp_od(SEXP netdfSEXP, SEXP start_nodesSEXP, SEXP end_nodesSEXP, SEXP etaSEXP, SEXP solverSEXP, SEXP tolSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::DataFrame >::type netdf(netdfSEXP);
+    Rcpp::traits::input_parameter< std::vector <std::string> >::type start_nodes(start_nodesSEXP);
+    Rcpp::traits::input_parameter< std::vector <std::string> >::type end_nodes(end_nodesSEXP);
+    Rcpp::traits::input_parameter< double >::type eta(etaSEXP);
+    Rcpp::traits::input_parameter< std::string >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< double >::type tol(tolSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_router_rsp_od(netdf, start_nodes, end_nodes, eta, solver, tol));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_vertex_index
+SEXP rcpp_vertex_index(Rcpp::DataFrame netdf);
+RcppExport SEXP _osmprob_rcpp_vertex_index(SEXP netdfSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::DataFrame >::type netdf(netdfSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_vertex_index(netdf));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_index_nearest
+Rcpp::CharacterVector rcpp_index_nearest(SEXP index, std::vector <double> qlon, std::vector <double> qlat, std::string vertices);
+RcppExport SEXP _osmprob_rcpp_index_nearest(SEXP indexSEXP, SEXP qlonSEXP, SEXP qlatSEXP, SEXP verticesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type index(indexSEXP);
+    Rcpp::traits::input_parameter< std::vector <double> >::type qlon(qlonSEXP);
+    Rcpp::traits::input_parameter< std::vector <double> >::type qlat(qlatSEXP);
+    Rcpp::traits::input_parameter< std::string >::type vertices(verticesSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_index_nearest(index, qlon, qlat, vertices));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_graph_nearest
+Rcpp::CharacterVector rcpp_graph_nearest(Rcpp::DataFrame netdf, std::vector <double> qlon, std::vector <double> qlat, std::string vertices);
+RcppExport SEXP _osmprob_rcpp_graph_nearest(SEXP netdfSEXP, SEXP qlonSEXP, SEXP qlatSEXP, SEXP verticesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::DataFrame >::type netdf(netdfSEXP);
+    Rcpp::traits::input_parameter< std::vector <double> >::type qlon(qlonSEXP);
+    Rcpp::traits::input_parameter< std::vector <double> >::type qlat(qlatSEXP);
+    Rcpp::traits::input_parameter< std::string >::type vertices(verticesSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_graph_nearest(netdf, qlon, qlat, vertices));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -0,0 +1,73 @@
+/***************************************************************************
+ *  Project:    osmprob
+ *  File:       astar.h
+ *  Language:   C++
+ *
+ *  osmprob is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  osmprob is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  osm-router.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Author:     Mark Padgham 
+ *  E-Mail:     mark.padgham@email.com 
+ *
+ *  Description:    Great-circle lower bound used as the A* heuristic of
+ *                  DijkstraSearch::run_astar
+ *
+ *  Limitations:    Edge distances must have been calculated with the same
+ *                  haversine function, as done in rcpp_lines_as_network.
+ *
+ *  Dependencies:       none
+ *
+ *  Compiler Options:   -std=c++11 
+ ***************************************************************************/
+
+#pragma once
+
+#include <vector>
+#include <limits>
+
+#include "graph-csr.h"
+#include "haversine.h"
+
+/* Edge weights are distances multiplied by a highway-dependent factor from the
+ * weighting profile, so the smallest such factor times the great circle
+ * distance to the target is a lower bound on the weighted distance. The bound
+ * is relaxed slightly to absorb single-precision rounding in edge distances. */
+struct HaversineHeuristic
+{
+    // Per dense vertex
+    const std::vector <double> &lon, &lat;
+    double factor, target_lon, target_lat;
+
+    static constexpr double slack = 0.999;
+
+    HaversineHeuristic (const std::vector <double> &lon,
+            const std::vector <double> &lat, double factor, index_t target)
+        : lon (lon), lat (lat), factor (factor * slack),
+            target_lon (lon [target]), target_lat (lat [target]) { }
+
+    weight_t operator () (index_t v) const
+    {
+        return factor * haversine (lon [v], lat [v], target_lon, target_lat);
+    }
+
+    // Smallest ratio of weight to distance over all edges
+    static double min_weight_factor (const std::vector <weight_t> &d,
+            const std::vector <weight_t> &w)
+    {
+        double f = std::numeric_limits <double>::infinity ();
+        for (size_t i = 0; i < d.size (); i++)
+            if (d [i] > 0.0 && w [i] / d [i] < f)
+                f = w [i] / d [i];
+        return (f == std::numeric_limits <double>::infinity ()) ? 0.0 : f;
+    }
+};
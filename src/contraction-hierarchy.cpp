@@ -0,0 +1,404 @@
+/***************************************************************************
+ *  Project:    osmprob
+ *  File:       contraction-hierarchy.cpp
+ *  Language:   C++
+ *
+ *  osmprob is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  osmprob is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  osm-router.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Construction and querying of contraction hierarchies
+ *
+ *  Limitations:
+ *
+ *  Dependencies:       none
+ *
+ *  Compiler Options:   -std=c++11
+ ***************************************************************************/
+
+#include <queue>
+#include <functional>
+#include <utility>
+
+#include "contraction-hierarchy.h"
+
+namespace {
+
+// Witness searches are abandoned after settling this many vertices, in which
+// case a possibly superfluous shortcut is added. This never affects the
+// correctness of queries, only the number of shortcuts.
+const index_t witness_settle_limit = 500;
+
+struct shortcut_t
+{
+    index_t from, to;
+    weight_t weight;
+    index_t child1, child2;
+};
+
+/* Working state for contraction. out_e and in_e hold indices into edges of the
+ * live edges between uncontracted vertices, with at most one edge for each
+ * ordered pair of vertices. */
+class CHBuilder
+{
+    private:
+        std::vector <ch_edge_t> &edges;
+        std::vector <std::vector <index_t> > out_e, in_e;
+        std::vector <bool> contracted;
+        std::vector <int> deleted_nbs;
+
+        // Witness search scratch
+        Heap4 heap;
+        std::vector <weight_t> dist;
+        std::vector <index_t> touched;
+
+        static void remove_from (std::vector <index_t> &list, index_t e)
+        {
+            for (size_t i = 0; i < list.size (); i++)
+                if (list [i] == e)
+                {
+                    list [i] = list.back ();
+                    list.pop_back ();
+                    return;
+                }
+        }
+
+        void witness_search (index_t source, index_t avoid, weight_t max_dist)
+        {
+            for (auto v: touched)
+                dist [v] = std::numeric_limits <weight_t>::infinity ();
+            touched.clear ();
+            heap.clear ();
+
+            dist [source] = 0.0;
+            touched.push_back (source);
+            heap.push (source, 0.0);
+            index_t nsettled = 0;
+            while (!heap.empty () && heap.top_key () <= max_dist &&
+                    nsettled++ < witness_settle_limit)
+            {
+                const weight_t du = heap.top_key ();
+                const index_t u = heap.pop ();
+                for (auto e: out_e [u])
+                {
+                    const index_t v = edges [e].to;
+                    if (v == avoid)
+                        continue;
+                    const weight_t dv = du + edges [e].weight;
+                    if (dv < dist [v])
+                    {
+                        if (dist [v] == std::numeric_limits <weight_t>::infinity ())
+                            touched.push_back (v);
+                        dist [v] = dv;
+                        heap.push (v, dv);
+                    }
+                }
+            }
+        }
+
+        void add_edge (const shortcut_t &sc)
+        {
+            for (auto e: out_e [sc.from])
+                if (edges [e].to == sc.to)
+                {
+                    if (edges [e].weight <= sc.weight)
+                        return;
+                    // Superseded edges remain in edges, because they may be
+                    // children of earlier shortcuts.
+                    remove_from (out_e [sc.from], e);
+                    remove_from (in_e [sc.to], e);
+                    break;
+                }
+            ch_edge_t edge = {sc.from, sc.to, sc.weight, sc.child1, sc.child2,
+                no_vertex};
+            out_e [sc.from].push_back (edges.size ());
+            in_e [sc.to].push_back (edges.size ());
+            edges.push_back (edge);
+        }
+
+    public:
+        CHBuilder (const csr_graph_t &g, std::vector <ch_edge_t> &edges)
+            : edges (edges)
+        {
+            const index_t n = g.nvertices ();
+            out_e.resize (n);
+            in_e.resize (n);
+            contracted.assign (n, false);
+            deleted_nbs.assign (n, 0);
+            heap.resize (n);
+            dist.assign (n, std::numeric_limits <weight_t>::infinity ());
+
+            edges.clear ();
+            for (index_t u = 0; u < n; u++)
+                for (index_t k = g.offsets [u]; k < g.offsets [u + 1]; k++)
+                {
+                    if (g.targets [k] == u)
+                        continue; // self-loops never lie on shortest paths
+                    const ch_edge_t edge = {u, g.targets [k], g.weights [k],
+                        no_vertex, no_vertex, g.edge_index [k]};
+                    // retain only the shortest of any parallel edges
+                    bool parallel = false;
+                    for (auto &e: out_e [u])
+                        if (edges [e].to == edge.to)
+                        {
+                            parallel = true;
+                            if (edge.weight < edges [e].weight)
+                                edges [e] = edge;
+                            break;
+                        }
+                    if (!parallel)
+                    {
+                        out_e [u].push_back (edges.size ());
+                        in_e [edge.to].push_back (edges.size ());
+                        edges.push_back (edge);
+                    }
+                }
+        }
+
+        // Shortcuts that contraction of v would require
+        void find_shortcuts (index_t v, std::vector <shortcut_t> &shortcuts)
+        {
+            shortcuts.clear ();
+            for (auto ein: in_e [v])
+            {
+                const index_t u = edges [ein].from;
+                weight_t max_dist = -1.0;
+                for (auto eout: out_e [v])
+                    if (edges [eout].to != u)
+                        max_dist = std::max (max_dist,
+                                edges [ein].weight + edges [eout].weight);
+                if (max_dist < 0.0)
+                    continue; // no out-neighbours other than u
+
+                witness_search (u, v, max_dist);
+                for (auto eout: out_e [v])
+                {
+                    const index_t w = edges [eout].to;
+                    const weight_t d = edges [ein].weight + edges [eout].weight;
+                    if (w != u && dist [w] > d)
+                        shortcuts.push_back ({u, w, d, ein, eout});
+                }
+            }
+        }
+
+        /* Twice the edge difference plus the number of already contracted
+         * neighbours, the latter spreading contraction evenly over the graph */
+        int priority (index_t v, std::vector <shortcut_t> &shortcuts)
+        {
+            find_shortcuts (v, shortcuts);
+            return 2 * (static_cast <int> (shortcuts.size ()) -
+                static_cast <int> (in_e [v].size () + out_e [v].size ())) +
+                deleted_nbs [v];
+        }
+
+        /* Contracts v, appending its remaining edges, all of which lead to
+         * vertices of higher rank, to the upward and downward edge lists. */
+        void contract (index_t v, const std::vector <shortcut_t> &shortcuts,
+                std::vector <index_t> &up_edges,
+                std::vector <index_t> &down_edges)
+        {
+            for (auto &sc: shortcuts)
+                add_edge (sc);
+
+            for (auto e: out_e [v])
+            {
+                up_edges.push_back (e);
+                remove_from (in_e [edges [e].to], e);
+                deleted_nbs [edges [e].to]++;
+            }
+            for (auto e: in_e [v])
+            {
+                down_edges.push_back (e);
+                remove_from (out_e [edges [e].from], e);
+                deleted_nbs [edges [e].from]++;
+            }
+            out_e [v].clear ();
+            out_e [v].shrink_to_fit ();
+            in_e [v].clear ();
+            in_e [v].shrink_to_fit ();
+            contracted [v] = true;
+        }
+};
+
+// CSR graph over the given subset of edges, keyed on the vertex at_from ?
+// edge.from : edge.to
+csr_graph_t make_csr (index_t n, const std::vector <ch_edge_t> &edges,
+        const std::vector <index_t> &subset, bool at_from)
+{
+    csr_graph_t g;
+    g.offsets.assign (n + 1, 0);
+    for (auto e: subset)
+        g.offsets [(at_from ? edges [e].from : edges [e].to) + 1]++;
+    for (index_t i = 0; i < n; i++)
+        g.offsets [i + 1] += g.offsets [i];
+
+    g.targets.resize (subset.size ());
+    g.weights.resize (subset.size ());
+    g.edge_index.resize (subset.size ());
+    std::vector <index_t> pos (g.offsets.begin (), g.offsets.end () - 1);
+    for (auto e: subset)
+    {
+        const index_t k = pos [at_from ? edges [e].from : edges [e].to]++;
+        g.targets [k] = at_from ? edges [e].to : edges [e].from;
+        g.weights [k] = edges [e].weight;
+        g.edge_index [k] = e;
+    }
+    return g;
+}
+
+} // end anonymous namespace
+
+/************************************************************************
+ ************************************************************************
+ **                                                                    **
+ **                       CONTRACTIONHIERARCHY                         **
+ **                                                                    **
+ ************************************************************************
+ ************************************************************************/
+
+void ContractionHierarchy::build (const csr_graph_t &g)
+{
+    const index_t n = g.nvertices ();
+    CHBuilder builder (g, edges);
+
+    // Lazy priority updates: a popped vertex has its priority recomputed, and
+    // is only contracted if it remains no larger than the next in the queue.
+    typedef std::pair <int, index_t> pq_t;
+    std::priority_queue <pq_t, std::vector <pq_t>, std::greater <pq_t> > pq;
+    std::vector <shortcut_t> shortcuts;
+    for (index_t v = 0; v < n; v++)
+        pq.push (std::make_pair (builder.priority (v, shortcuts), v));
+
+    rank.assign (n, 0);
+    std::vector <index_t> up_edges, down_edges;
+    index_t order = 0;
+    while (!pq.empty ())
+    {
+        const index_t v = pq.top ().second;
+        pq.pop ();
+        const int p = builder.priority (v, shortcuts);
+        if (!pq.empty () && p > pq.top ().first)
+        {
+            pq.push (std::make_pair (p, v));
+            continue;
+        }
+        builder.contract (v, shortcuts, up_edges, down_edges);
+        rank [v] = order++;
+    }
+
+    up = make_csr (n, edges, up_edges, true);
+    down_rev = make_csr (n, edges, down_edges, false);
+}
+
+size_t ContractionHierarchy::nshortcuts () const
+{
+    size_t n = 0;
+    for (auto &e: edges)
+        if (e.is_shortcut ())
+            n++;
+    return n;
+}
+
+void ContractionHierarchy::unpack (index_t e,
+        std::vector <index_t> &orig_edges) const
+{
+    std::vector <index_t> stack (1, e);
+    while (!stack.empty ())
+    {
+        const index_t ei = stack.back ();
+        stack.pop_back ();
+        if (edges [ei].is_shortcut ())
+        {
+            stack.push_back (edges [ei].child2);
+            stack.push_back (edges [ei].child1);
+        } else
+            orig_edges.push_back (edges [ei].orig);
+    }
+}
+
+/************************************************************************
+ ************************************************************************
+ **                                                                    **
+ **                              CHQUERY                               **
+ **                                                                    **
+ ************************************************************************
+ ************************************************************************/
+
+index_t CHQuery::edge_between (const csr_graph_t &g, index_t u, index_t v)
+{
+    index_t e = no_vertex;
+    weight_t w = std::numeric_limits <weight_t>::infinity ();
+    for (index_t k = g.offsets [u]; k < g.offsets [u + 1]; k++)
+        if (g.targets [k] == v && g.weights [k] < w)
+        {
+            e = g.edge_index [k];
+            w = g.weights [k];
+        }
+    return e;
+}
+
+/* Both searches only ascend in rank, so neither alone finds shortest paths,
+ * and the usual bidirectional stopping criterion does not apply. Instead each
+ * side continues until its own frontier exceeds the best connection found. */
+weight_t CHQuery::run (const ContractionHierarchy &ch, index_t source,
+        index_t target, std::vector <index_t> &path_edges)
+{
+    path_edges.clear ();
+    distance = std::numeric_limits <weight_t>::infinity ();
+    meet = no_vertex;
+    fwd.init (ch.up, source);
+    bwd.init (ch.down_rev, target);
+    if (source == target)
+        return distance = 0.0;
+
+    auto fwd_update = [this] (index_t v, weight_t d) {
+        if (d + bwd.dist [v] < distance)
+        {
+            distance = d + bwd.dist [v];
+            meet = v;
+        }
+    };
+    auto bwd_update = [this] (index_t v, weight_t d) {
+        if (d + fwd.dist [v] < distance)
+        {
+            distance = d + fwd.dist [v];
+            meet = v;
+        }
+    };
+
+    while (true)
+    {
+        const bool fwd_go = fwd.frontier () < distance,
+              bwd_go = bwd.frontier () < distance;
+        if (!fwd_go && !bwd_go)
+            break;
+        if (fwd_go && (!bwd_go || fwd.frontier () <= bwd.frontier ()))
+            fwd.settle_next (ch.up, fwd_update);
+        else
+            bwd.settle_next (ch.down_rev, bwd_update);
+    }
+
+    if (meet == no_vertex)
+        return distance;
+
+    std::vector <index_t> up_path = fwd.path_to (meet);
+    for (size_t i = 1; i < up_path.size (); i++)
+        ch.unpack (edge_between (ch.up, up_path [i - 1], up_path [i]),
+                path_edges);
+    for (index_t v = meet; v != target; v = bwd.prev [v])
+        ch.unpack (edge_between (ch.down_rev, bwd.prev [v], v), path_edges);
+
+    return distance;
+}
@@ -0,0 +1,99 @@
+/***************************************************************************
+ *  Project:    osmprob
+ *  File:       contraction-hierarchy.h
+ *  Language:   C++
+ *
+ *  osmprob is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  osmprob is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  osm-router.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Contraction hierarchies (Geisberger et al. 2008) over the
+ *                  compact graph: a one-off preprocessing stage which orders
+ *                  vertices by importance and adds shortcut edges, after which
+ *                  shortest paths only require two small upward searches.
+ *
+ *  Limitations:    Edge weights must be non-negative. The graph is static;
+ *                  any change to weights requires a rebuild.
+ *
+ *  Dependencies:       none (no Rcpp, so usable from threaded code)
+ *
+ *  Compiler Options:   -std=c++11
+ ***************************************************************************/
+
+#pragma once
+
+#include <vector>
+
+#include "graph-csr.h"
+#include "dijkstra.h"
+
+/* Edges of the hierarchy are either edges of the input graph (orig holds the
+ * position in the input edge list) or shortcuts, which replace the two-edge
+ * path child1 -> child2 via a contracted vertex. */
+struct ch_edge_t
+{
+    index_t from, to;
+    weight_t weight;
+    index_t child1, child2, orig;
+
+    bool is_shortcut () const { return child1 != no_vertex; }
+};
+
+class ContractionHierarchy
+{
+    public:
+        // Contraction order of each dense vertex; higher is more important
+        std::vector <index_t> rank;
+        std::vector <ch_edge_t> edges;
+        /* The upward graph holds edges u -> v with rank [u] < rank [v]; the
+         * downward graph holds edges u -> v with rank [u] > rank [v], stored
+         * reversed at v, so that both query searches only ascend in rank.
+         * Their edge_index entries index edges. */
+        csr_graph_t up, down_rev;
+
+        void build (const csr_graph_t &g);
+
+        index_t nvertices () const { return rank.size (); }
+        size_t nshortcuts () const;
+
+        // Appends the input edge positions represented by edge e, in path order
+        void unpack (index_t e, std::vector <index_t> &orig_edges) const;
+};
+
+/* Query scratch is kept separate from the hierarchy itself, so that one
+ * hierarchy may be shared read-only between any number of queries. */
+class CHQuery
+{
+    private:
+        DijkstraSearch fwd, bwd;
+        index_t meet;
+
+        // Edge of g from u to v which realises dist (v) - dist (u)
+        static index_t edge_between (const csr_graph_t &g, index_t u,
+                index_t v);
+
+    public:
+        weight_t distance;
+
+        /* Returns the shortest distance from source to target, which is
+         * infinite if target is unreachable. The input edge positions of the
+         * path are written to path_edges. */
+        weight_t run (const ContractionHierarchy &ch, index_t source,
+                index_t target, std::vector <index_t> &path_edges);
+
+        // Work done by both searches of the latest query
+        size_t nsettled () const { return fwd.nsettled + bwd.nsettled; }
+        size_t nheap_ops () const { return fwd.nheap_ops + bwd.nheap_ops; }
+};
@@ -0,0 +1,398 @@
+/***************************************************************************
+ *  Project:    osmprob
+ *  File:       dijkstra.h
+ *  Language:   C++
+ *
+ *  osmprob is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  osmprob is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  osm-router.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Author:     Mark Padgham 
+ *  E-Mail:     mark.padgham@email.com 
+ *
+ *  Description:    Dijkstra shortest paths on any densely indexed graph,
+ *                  using an indexed 4-ary heap.
+ *
+ *  Limitations:    Graphs must expose nvertices () and CSR vectors offsets,
+ *                  targets and weights, as does csr_graph_t.
+ *
+ *  Dependencies:       none (no Rcpp, so usable from threaded code)
+ *
+ *  Compiler Options:   -std=c++11 
+ ***************************************************************************/
+
+#pragma once
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include "graph-csr.h"
+
+const index_t no_vertex = std::numeric_limits <index_t>::max ();
+
+/************************************************************************
+ ************************************************************************
+ **                                                                    **
+ **                            HEAP4                                   **
+ **                                                                    **
+ ************************************************************************
+ ************************************************************************/
+
+/* Min-heap of dense vertex indices keyed on weight_t, with each vertex's heap
+ * position stored so that decrease-key is an in-place sift-up. A 4-ary layout
+ * halves the depth of a binary heap, and the four children of a node share a
+ * cache line of the heap array. No allocations occur once the arrays have been
+ * sized to the graph. */
+class Heap4
+{
+    private:
+        std::vector <index_t> heap, pos;
+        std::vector <weight_t> key;
+
+        void sift_up (size_t i)
+        {
+            const index_t v = heap [i];
+            const weight_t k = key [v];
+            while (i > 0)
+            {
+                const size_t parent = (i - 1) / 4;
+                if (key [heap [parent]] <= k)
+                    break;
+                heap [i] = heap [parent];
+                pos [heap [i]] = i;
+                i = parent;
+            }
+            heap [i] = v;
+            pos [v] = i;
+        }
+
+        void sift_down (size_t i)
+        {
+            const size_t n = heap.size ();
+            const index_t v = heap [i];
+            const weight_t k = key [v];
+            while (true)
+            {
+                const size_t c0 = 4 * i + 1;
+                if (c0 >= n)
+                    break;
+                const size_t cend = std::min (c0 + 4, n);
+                size_t cmin = c0;
+                for (size_t c = c0 + 1; c < cend; c++)
+                    if (key [heap [c]] < key [heap [cmin]])
+                        cmin = c;
+                if (key [heap [cmin]] >= k)
+                    break;
+                heap [i] = heap [cmin];
+                pos [heap [i]] = i;
+                i = cmin;
+            }
+            heap [i] = v;
+            pos [v] = i;
+        }
+
+    public:
+        void resize (index_t nvertices)
+        {
+            heap.clear ();
+            heap.reserve (nvertices);
+            pos.assign (nvertices, no_vertex);
+            key.resize (nvertices);
+        }
+
+        bool empty () const { return heap.empty (); }
+        size_t size () const { return heap.size (); }
+        bool contains (index_t v) const { return pos [v] != no_vertex; }
+        weight_t top_key () const { return key [heap.front ()]; }
+
+        // Insert v, or decrease its key if already present
+        void push (index_t v, weight_t k)
+        {
+            key [v] = k;
+            if (pos [v] == no_vertex)
+            {
+                heap.push_back (v);
+                sift_up (heap.size () - 1);
+            } else
+                sift_up (pos [v]);
+        }
+
+        index_t pop ()
+        {
+            const index_t v = heap.front ();
+            pos [v] = no_vertex;
+            const index_t last = heap.back ();
+            heap.pop_back ();
+            if (!heap.empty ())
+            {
+                heap [0] = last;
+                sift_down (0);
+            }
+            return v;
+        }
+
+        void clear ()
+        {
+            for (auto v: heap)
+                pos [v] = no_vertex;
+            heap.clear ();
+        }
+};
+
+/************************************************************************
+ ************************************************************************
+ **                                                                    **
+ **                         DIJKSTRASEARCH                             **
+ **                                                                    **
+ ************************************************************************
+ ************************************************************************/
+
+struct no_op_t
+{
+    void operator () (index_t, weight_t) const { }
+};
+
+/* Scratch buffers are sized on first use and retained between queries. Only
+ * the vertices reached by the previous query are reset, so a query costs
+ * O(reached) rather than O(nvertices) regardless of graph size.
+ *
+ * Searches may either be run to completion, stopped once a target vertex is
+ * settled, or advanced one settled vertex at a time with init and
+ * settle_next, as used by the bidirectional search. */
+class DijkstraSearch
+{
+    private:
+        Heap4 heap;
+        std::vector <index_t> touched;
+
+        void reset (index_t nvertices)
+        {
+            if (dist.size () != nvertices)
+            {
+                dist.assign (nvertices, std::numeric_limits <weight_t>::infinity ());
+                prev.assign (nvertices, no_vertex);
+                heap.resize (nvertices);
+                touched.clear ();
+            } else
+            {
+                for (auto v: touched)
+                {
+                    dist [v] = std::numeric_limits <weight_t>::infinity ();
+                    prev [v] = no_vertex;
+                }
+                touched.clear ();
+                heap.clear ();
+            }
+        }
+
+    public:
+        // Results of the latest query, indexed by dense vertex index
+        std::vector <weight_t> dist;
+        std::vector <index_t> prev;
+        // Work done by the latest query: vertices popped from the heap, and
+        // all heap pushes and pops
+        size_t nsettled = 0, nheap_ops = 0;
+
+        template <typename graph_t>
+        void init (const graph_t &g, index_t source)
+        {
+            reset (g.nvertices ());
+            dist [source] = 0.0;
+            touched.push_back (source);
+            heap.push (source, 0.0);
+            nsettled = 0;
+            nheap_ops = 1;
+        }
+
+        bool finished () const { return heap.empty (); }
+        // Lower bound on the distance of all vertices yet to be settled
+        weight_t frontier () const
+        {
+            return heap.empty () ? std::numeric_limits <weight_t>::infinity () :
+                heap.top_key ();
+        }
+
+        /* Settle and return the closest unsettled vertex. on_update (v, d) is
+         * called whenever the tentative distance of v decreases to d. */
+        template <typename graph_t, typename update_t = no_op_t>
+        index_t settle_next (const graph_t &g, update_t on_update = update_t ())
+        {
+            const weight_t du = heap.top_key ();
+            const index_t u = heap.pop ();
+            nsettled++;
+            nheap_ops++;
+            for (index_t k = g.offsets [u]; k < g.offsets [u + 1]; k++)
+            {
+                const index_t v = g.targets [k];
+                const weight_t dv = du + g.weights [k];
+                if (dv < dist [v])
+                {
+                    // first visit, excluding the source which has dist = 0
+                    if (prev [v] == no_vertex && dist [v] > 0.0)
+                        touched.push_back (v);
+                    dist [v] = dv;
+                    prev [v] = u;
+                    heap.push (v, dv);
+                    nheap_ops++;
+                    on_update (v, dv);
+                }
+            }
+            return u;
+        }
+
+        /* Full one-to-all search, or, if target is given, a point-to-point
+         * search which stops as soon as target is settled. dist and prev are
+         * then final for target and every vertex closer than it. */
+        template <typename graph_t>
+        void run (const graph_t &g, index_t source,
+                index_t target = no_vertex)
+        {
+            init (g, source);
+            while (!heap.empty ())
+                if (settle_next (g) == target)
+                    break;
+        }
+
+        /* A* search from source to target, with heuristic (v) returning a
+         * lower bound on the distance from v to target. Heap keys are then
+         * dist [v] + heuristic (v). Vertices are re-opened if a shorter path
+         * is found after they have been settled, so the result is exact for
+         * any admissible heuristic, even one that is not strictly consistent
+         * because of rounding. */
+        template <typename graph_t, typename heuristic_t>
+        void run_astar (const graph_t &g, index_t source, index_t target,
+                heuristic_t &heuristic)
+        {
+            init (g, source);
+            heap.push (source, heuristic (source)); // the only heap entry
+            while (!heap.empty ())
+            {
+                const index_t u = heap.pop ();
+                nsettled++;
+                nheap_ops++;
+                if (u == target)
+                    break;
+                const weight_t du = dist [u];
+                for (index_t k = g.offsets [u]; k < g.offsets [u + 1]; k++)
+                {
+                    const index_t v = g.targets [k];
+                    const weight_t dv = du + g.weights [k];
+                    if (dv < dist [v])
+                    {
+                        if (prev [v] == no_vertex && dist [v] > 0.0)
+                            touched.push_back (v);
+                        dist [v] = dv;
+                        prev [v] = u;
+                        heap.push (v, dv + heuristic (v));
+                        nheap_ops++;
+                    }
+                }
+            }
+        }
+
+        // Dense indices from source to target; empty if target is unreachable
+        std::vector <index_t> path_to (index_t target) const
+        {
+            std::vector <index_t> path;
+            if (dist [target] == std::numeric_limits <weight_t>::infinity ())
+                return path;
+            for (index_t v = target; v != no_vertex; v = prev [v])
+                path.push_back (v);
+            std::reverse (path.begin (), path.end ());
+            return path;
+        }
+};
+
+/************************************************************************
+ ************************************************************************
+ **                                                                    **
+ **                       BIDIRECTIONALDIJKSTRA                        **
+ **                                                                    **
+ ************************************************************************
+ ************************************************************************/
+
+/* Alternates between a forward search from the source over g and a backward
+ * search from the target over the reverse graph, always advancing the side with
+ * the smaller frontier. The best connection found so far, mu, is the minimum of
+ * dist_fwd [v] + dist_bwd [v] over all vertices labelled by both sides, and the
+ * search stops once the two frontiers sum to at least mu. */
+class BidirectionalDijkstra
+{
+    private:
+        DijkstraSearch fwd, bwd;
+        index_t source, target;
+
+    public:
+        weight_t distance;
+        index_t meet;
+
+        template <typename graph_t>
+        void run (const graph_t &g, const graph_t &g_rev,
+                index_t source, index_t target)
+        {
+            this->source = source;
+            this->target = target;
+            distance = std::numeric_limits <weight_t>::infinity ();
+            meet = no_vertex;
+            fwd.init (g, source);
+            bwd.init (g_rev, target);
+            if (source == target)
+            {
+                distance = 0.0;
+                meet = source;
+                return;
+            }
+
+            auto fwd_update = [this] (index_t v, weight_t d) {
+                if (d + bwd.dist [v] < distance)
+                {
+                    distance = d + bwd.dist [v];
+                    meet = v;
+                }
+            };
+            auto bwd_update = [this] (index_t v, weight_t d) {
+                if (d + fwd.dist [v] < distance)
+                {
+                    distance = d + fwd.dist [v];
+                    meet = v;
+                }
+            };
+
+            while (!fwd.finished () || !bwd.finished ())
+            {
+                if (fwd.frontier () + bwd.frontier () >= distance)
+                    break;
+                if (fwd.frontier () <= bwd.frontier ())
+                    fwd.settle_next (g, fwd_update);
+                else
+                    bwd.settle_next (g_rev, bwd_update);
+            }
+        }
+
+        // Work done by both searches of the latest query
+        size_t nsettled () const { return fwd.nsettled + bwd.nsettled; }
+        size_t nheap_ops () const { return fwd.nheap_ops + bwd.nheap_ops; }
+
+        // Dense indices from source to target; empty if target is unreachable
+        std::vector <index_t> path () const
+        {
+            std::vector <index_t> p;
+            if (meet == no_vertex)
+                return p;
+            p = fwd.path_to (meet);
+            // Predecessors of the backward search lead towards the target
+            for (index_t v = bwd.prev [meet]; v != no_vertex; v = bwd.prev [v])
+                p.push_back (v);
+            return p;
+        }
+};
@@ -0,0 +1,521 @@
+/***************************************************************************
+ *  Project:    osmprob
+ *  File:       graph-cache.cpp
+ *  Language:   C++
+ *
+ *  osmprob is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  osmprob is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  osm-router.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Writing and loading of binary graph files, as described
+ *                  in graph-cache.h.
+ *
+ *  Limitations:
+ *
+ *  Dependencies:       none
+ *
+ *  Compiler Options:   -std=c++11
+ ***************************************************************************/
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include <Rcpp.h>
+
+#include "graph-cache.h"
+#include "network-columns.h"
+
+const char graph_cache_magic [8] = {'O', 'S', 'M', 'P', 'R', 'O', 'B', 'G'};
+
+// Element sizes and counts of each section
+const size_t graph_cache_sizes [gc_nsections] = {
+    8, 8, 8, 4, 4, 4, 8, 8, 4, 4, 4, 4, 8, 8, 4, 4, 4, 1};
+
+void graph_cache_counts (const graph_cache_header_t &h,
+        uint64_t counts [gc_nsections])
+{
+    const uint64_t nv = h.nvertices, nc = h.ncompact, no = h.noriginal;
+    const uint64_t counts_h [gc_nsections] = {
+        nv, nv, nv, nv + 1, nc, nc, nc, h.nweights * nc, nc,
+        no, no, no, no, h.nweights * no, no, h.nmap, h.nmap, h.strings_size};
+    std::copy (counts_h, counts_h + gc_nsections, counts);
+}
+
+graph_cache_layout_t graph_cache_layout (const graph_cache_header_t &h)
+{
+    uint64_t counts [gc_nsections];
+    graph_cache_counts (h, counts);
+
+    graph_cache_layout_t layout;
+    size_t pos = sizeof (graph_cache_header_t);
+    for (int s = 0; s < gc_nsections; s++)
+    {
+        layout [s] = pos;
+        pos += counts [s] * graph_cache_sizes [s];
+        pos = (pos + 7) & ~static_cast <size_t> (7);
+    }
+    layout [gc_nsections] = pos;
+    return layout;
+}
+
+template <typename T>
+void write_section (std::FILE *f, const std::vector <T> &x)
+{
+    const size_t nbytes = x.size () * sizeof (T);
+    if (nbytes > 0 && std::fwrite (&x [0], 1, nbytes, f) != nbytes)
+        throw std::runtime_error ("unable to write graph file");
+    const char pad [8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    const size_t npad = (8 - nbytes % 8) % 8;
+    if (npad > 0 && std::fwrite (pad, 1, npad, f) != npad)
+        throw std::runtime_error ("unable to write graph file");
+}
+
+/* Files are written under a temporary name and then renamed, so that no
+ * process ever reads a partial file. */
+void write_graph_cache (const std::string &filename,
+        const graph_cache_data_t &data)
+{
+    std::vector <char> strings;
+    for (auto s: data.highways)
+        strings.insert (strings.end (), s.c_str (), s.c_str () + s.size () + 1);
+    for (auto s: data.weight_names)
+        strings.insert (strings.end (), s.c_str (), s.c_str () + s.size () + 1);
+
+    graph_cache_header_t h;
+    std::memset (&h, 0, sizeof (h));
+    std::memcpy (h.magic, graph_cache_magic, sizeof (h.magic));
+    h.version = graph_cache_version;
+    h.byte_order = graph_cache_byte_order;
+    h.nvertices = data.vertex_id.size ();
+    h.ncompact = data.compact_to.size ();
+    h.noriginal = data.original_from.size ();
+    h.nmap = data.map_compact.size ();
+    h.nweights = data.weight_names.size ();
+    h.nhighways = data.highways.size ();
+    h.strings_size = strings.size ();
+    h.file_size = graph_cache_layout (h) [gc_nsections];
+
+    const std::string tmpname = filename + ".tmp";
+    std::FILE *f = std::fopen (tmpname.c_str (), "wb");
+    if (!f)
+        throw std::runtime_error ("unable to open file " + tmpname);
+    try
+    {
+        if (std::fwrite (&h, sizeof (h), 1, f) != 1)
+            throw std::runtime_error ("unable to write graph file");
+        write_section (f, data.vertex_id);
+        write_section (f, data.lon);
+        write_section (f, data.lat);
+        write_section (f, data.compact_offsets);
+        write_section (f, data.compact_to);
+        write_section (f, data.compact_edge_id);
+        write_section (f, data.compact_d);
+        write_section (f, data.compact_weights);
+        write_section (f, data.compact_highway);
+        write_section (f, data.original_from);
+        write_section (f, data.original_to);
+        write_section (f, data.original_edge_id);
+        write_section (f, data.original_d);
+        write_section (f, data.original_weights);
+        write_section (f, data.original_highway);
+        write_section (f, data.map_compact);
+        write_section (f, data.map_original);
+        write_section (f, strings);
+    } catch (...)
+    {
+        std::fclose (f);
+        std::remove (tmpname.c_str ());
+        throw;
+    }
+    if (std::fclose (f) != 0)
+    {
+        std::remove (tmpname.c_str ());
+        throw std::runtime_error ("unable to write graph file");
+    }
+
+#ifdef _WIN32
+    std::remove (filename.c_str ());
+#endif
+    if (std::rename (tmpname.c_str (), filename.c_str ()) != 0)
+    {
+        std::remove (tmpname.c_str ());
+        throw std::runtime_error ("unable to write file " + filename);
+    }
+}
+
+/* The file is read with a single call into a buffer of 8-byte words, so that
+ * every section is aligned for its element type. */
+GraphCache::GraphCache (const std::string &filename)
+    : _data (nullptr), _size (0)
+{
+    std::FILE *f = std::fopen (filename.c_str (), "rb");
+    if (!f)
+        throw std::runtime_error ("unable to open file " + filename);
+    long size = -1;
+    if (std::fseek (f, 0, SEEK_END) == 0)
+        size = std::ftell (f);
+    if (size < 0 || std::fseek (f, 0, SEEK_SET) != 0)
+    {
+        std::fclose (f);
+        throw std::runtime_error ("unable to read file " + filename);
+    }
+    _size = static_cast <size_t> (size);
+    _buf.resize ((_size + 7) / 8);
+    _data = reinterpret_cast <const char *> (_buf.data ());
+    const bool ok = _size == 0 ||
+        std::fread (&_buf [0], 1, _size, f) == _size;
+    std::fclose (f);
+    if (!ok)
+        throw std::runtime_error ("unable to read file " + filename);
+
+    validate ();
+}
+
+void GraphCache::validate ()
+{
+    if (_size < sizeof (graph_cache_header_t) ||
+            std::memcmp (_data, graph_cache_magic, 8) != 0)
+        throw std::runtime_error ("not an osmprob graph file");
+    const graph_cache_header_t &h = header ();
+    if (h.version != graph_cache_version)
+        throw std::runtime_error ("graph file is of version " +
+                std::to_string (h.version) + ", but version " +
+                std::to_string (graph_cache_version) + " is required");
+    if (h.byte_order != graph_cache_byte_order)
+        throw std::runtime_error ("graph file has the wrong byte order");
+
+    // Counts are checked before computing the layout, so it can not overflow
+    uint64_t counts [gc_nsections];
+    graph_cache_counts (h, counts);
+    for (int s = 0; s < gc_nsections; s++)
+        if (counts [s] > _size)
+            throw std::runtime_error ("graph file is corrupt");
+    if (h.nhighways > _size || (h.nweights > 0 &&
+                (h.ncompact > _size / h.nweights ||
+                 h.noriginal > _size / h.nweights)))
+        throw std::runtime_error ("graph file is corrupt");
+    _layout = graph_cache_layout (h);
+    if (h.file_size != _size || _layout [gc_nsections] != _size)
+        throw std::runtime_error ("graph file is truncated or corrupt");
+
+    const uint32_t *offsets = section <uint32_t> (gc_compact_offsets);
+    if (offsets [0] != 0 || offsets [h.nvertices] != h.ncompact)
+        throw std::runtime_error ("graph file is corrupt");
+    for (uint64_t v = 0; v < h.nvertices; v++)
+        if (offsets [v + 1] < offsets [v])
+            throw std::runtime_error ("graph file is corrupt");
+
+    const uint32_t *cto = section <uint32_t> (gc_compact_to),
+          *chw = section <uint32_t> (gc_compact_highway);
+    for (uint64_t e = 0; e < h.ncompact; e++)
+        if (cto [e] >= h.nvertices || chw [e] >= h.nhighways)
+            throw std::runtime_error ("graph file is corrupt");
+    const uint32_t *ofrom = section <uint32_t> (gc_original_from),
+          *oto = section <uint32_t> (gc_original_to),
+          *ohw = section <uint32_t> (gc_original_highway);
+    for (uint64_t e = 0; e < h.noriginal; e++)
+        if (ofrom [e] >= h.nvertices || oto [e] >= h.nvertices ||
+                ohw [e] >= h.nhighways)
+            throw std::runtime_error ("graph file is corrupt");
+
+    const char *str = section <char> (gc_strings);
+    uint64_t nstrings = 0;
+    for (uint64_t i = 0; i < h.strings_size; i++)
+        if (str [i] == '\0')
+            nstrings++;
+    if (nstrings != h.nhighways + h.nweights ||
+            (h.strings_size > 0 && str [h.strings_size - 1] != '\0'))
+        throw std::runtime_error ("graph file is corrupt");
+}
+
+std::vector <std::string> GraphCache::strings () const
+{
+    std::vector <std::string> s;
+    const char *str = section <char> (gc_strings);
+    const char *end = str + header ().strings_size;
+    while (str < end)
+    {
+        s.push_back (std::string (str));
+        str += s.back ().size () + 1;
+    }
+    return s;
+}
+
+/* Vertices of both graphs, interned as in graph.cpp, with highway types
+ * shared through data.highways */
+struct graph_cache_interner_t
+{
+    graph_cache_data_t &data;
+    vertex_ids_t ids;
+
+    graph_cache_interner_t (graph_cache_data_t &d) : data (d) {}
+
+    uint32_t vertex (vertex_t id, double lon, double lat)
+    {
+        const uint32_t v = ids.intern (id);
+        if (v == data.lon.size ())
+        {
+            data.lon.push_back (lon);
+            data.lat.push_back (lat);
+        }
+        return v;
+    }
+};
+
+inline int32_t edge_id_int (double id)
+{
+    // Checked before casting, as casting an out-of-range double is undefined;
+    // NaN fails both comparisons
+    if (!(id >= std::numeric_limits <int32_t>::min () &&
+                id <= std::numeric_limits <int32_t>::max ()) ||
+            id != std::floor (id))
+        throw std::runtime_error ("edge IDs must be integers within the "
+                "range of 32-bit integers");
+    return static_cast <int32_t> (id);
+}
+
+// Edges of one data.frame, with vertex indices and highways interned
+void graph_cache_edges (Rcpp::DataFrame df,
+        const std::vector <std::string> &weight_names,
+        graph_cache_interner_t &interner, std::vector <uint32_t> &from,
+        std::vector <uint32_t> &to, std::vector <uint32_t> &highway,
+        std::vector <int32_t> &edge_id, std::vector <double> &d,
+        std::vector <double> &weights)
+{
+    std::vector <vertex_t> from_id, to_id;
+    vertex_id_column (df ["from_id"], from_id);
+    vertex_id_column (df ["to_id"], to_id);
+    highway_column (df ["highway"], highway, interner.data.highways);
+    Rcpp::NumericVector from_lon = df ["from_lon"];
+    Rcpp::NumericVector from_lat = df ["from_lat"];
+    Rcpp::NumericVector to_lon = df ["to_lon"];
+    Rcpp::NumericVector to_lat = df ["to_lat"];
+    Rcpp::NumericVector eid = df ["edge_id"];
+    Rcpp::NumericVector dist = df ["d"];
+
+    const int n = from_id.size ();
+    from.resize (n);
+    to.resize (n);
+    edge_id.resize (n);
+    for (int i = 0; i < n; i++)
+    {
+        from [i] = interner.vertex (from_id [i], from_lon [i], from_lat [i]);
+        to [i] = interner.vertex (to_id [i], to_lon [i], to_lat [i]);
+        edge_id [i] = edge_id_int (eid [i]);
+    }
+    d.assign (dist.begin (), dist.end ());
+    weights.clear ();
+    for (auto w: weight_names)
+    {
+        Rcpp::NumericVector wi = df [w];
+        weights.insert (weights.end (), wi.begin (), wi.end ());
+    }
+}
+
+// A data.frame from a named list of columns, without any conversion
+Rcpp::List as_data_frame (Rcpp::List cols, size_t nrow)
+{
+    cols.attr ("class") = "data.frame";
+    cols.attr ("row.names") = Rcpp::IntegerVector::create (NA_INTEGER,
+            -static_cast <int> (nrow));
+    return cols;
+}
+
+//' rcpp_save_graph
+//'
+//' Write compact and original graphs and their map to a binary graph file
+//'
+//' @param compact The compact graph
+//' @param original The original graph
+//' @param map The map from compact to original edge IDs
+//' @param weight_names Names of the weight columns of both graphs, one for each
+//' weighting profile
+//' @param filename Name of file to write
+//'
+//' @noRd
+// [[Rcpp::export]]
+void rcpp_save_graph (Rcpp::DataFrame compact, Rcpp::DataFrame original,
+        Rcpp::DataFrame map, std::vector <std::string> weight_names,
+        std::string filename)
+{
+    graph_cache_data_t data;
+    graph_cache_interner_t interner (data);
+    data.weight_names = weight_names;
+
+    graph_cache_edges (original, weight_names, interner, data.original_from,
+            data.original_to, data.original_highway, data.original_edge_id,
+            data.original_d, data.original_weights);
+
+    std::vector <uint32_t> from, to, highway;
+    std::vector <int32_t> edge_id;
+    std::vector <double> d, weights;
+    graph_cache_edges (compact, weight_names, interner, from, to, highway,
+            edge_id, d, weights);
+    data.vertex_id = interner.ids.ids;
+
+    // Compact edges in CSR order, retaining their order within each vertex
+    const size_t nv = data.vertex_id.size (), ne = from.size ();
+    data.compact_offsets.assign (nv + 1, 0);
+    for (auto f: from)
+        data.compact_offsets [f + 1]++;
+    for (size_t v = 0; v < nv; v++)
+        data.compact_offsets [v + 1] += data.compact_offsets [v];
+    std::vector <uint32_t> pos (data.compact_offsets.begin (),
+            data.compact_offsets.end () - 1);
+    data.compact_to.resize (ne);
+    data.compact_highway.resize (ne);
+    data.compact_edge_id.resize (ne);
+    data.compact_d.resize (ne);
+    data.compact_weights.resize (weights.size ());
+    for (size_t e = 0; e < ne; e++)
+    {
+        const uint32_t i = pos [from [e]]++;
+        data.compact_to [i] = to [e];
+        data.compact_highway [i] = highway [e];
+        data.compact_edge_id [i] = edge_id [e];
+        data.compact_d [i] = d [e];
+        for (size_t w = 0; w < weight_names.size (); w++)
+            data.compact_weights [w * ne + i] = weights [w * ne + e];
+    }
+
+    Rcpp::NumericVector id_compact = map [0], id_original = map [1];
+    data.map_compact.resize (id_compact.size ());
+    data.map_original.resize (id_original.size ());
+    for (int i = 0; i < id_compact.size (); i++)
+    {
+        data.map_compact [i] = edge_id_int (id_compact [i]);
+        data.map_original [i] = edge_id_int (id_original [i]);
+    }
+
+    write_graph_cache (filename, data);
+}
+
+//' rcpp_load_graph
+//'
+//' Load compact and original graphs and their map from a binary graph file
+//'
+//' @param filename Name of file to load
+//'
+//' @return List of \code{compact}, \code{original} and \code{map}, as for
+//' \code{rcpp_make_compact_graph}, with compact edges in order of their from
+//' vertices
+//'
+//' @noRd
+// [[Rcpp::export]]
+Rcpp::List rcpp_load_graph (std::string filename)
+{
+    const GraphCache cache (filename);
+    const graph_cache_header_t &h = cache.header ();
+    const size_t nv = h.nvertices, nc = h.ncompact, no = h.noriginal;
+    const std::vector <std::string> strings = cache.strings ();
+    const std::vector <std::string> highways (strings.begin (),
+            strings.begin () + h.nhighways);
+    const std::vector <std::string> weight_names (
+            strings.begin () + h.nhighways, strings.end ());
+
+    const vertex_t *vid = cache.section <vertex_t> (gc_vertex_id);
+    const double *lon = cache.section <double> (gc_lon);
+    const double *lat = cache.section <double> (gc_lat);
+    // Compact graph
+    const uint32_t *offsets = cache.section <uint32_t> (gc_compact_offsets);
+    const uint32_t *cto = cache.section <uint32_t> (gc_compact_to);
+    const uint32_t *chw = cache.section <uint32_t> (gc_compact_highway);
+    const int32_t *ceid = cache.section <int32_t> (gc_compact_edge_id);
+    const double *cd = cache.section <double> (gc_compact_d);
+    const double *cw = cache.section <double> (gc_compact_weights);
+    // Both graphs as for rcpp_make_compact_graph, with numeric IDs and a
+    // highway factor
+    Rcpp::NumericVector c_from (nc), c_to (nc);
+    Rcpp::IntegerVector c_hw (nc);
+    Rcpp::NumericVector c_eid (nc), c_from_lon (nc), c_from_lat (nc),
+        c_to_lon (nc), c_to_lat (nc);
+    for (size_t v = 0; v < nv; v++)
+        for (uint32_t e = offsets [v]; e < offsets [v + 1]; e++)
+        {
+            c_from [e] = static_cast <double> (vid [v]);
+            c_to [e] = static_cast <double> (vid [cto [e]]);
+            c_hw [e] = static_cast <int> (chw [e]) + 1;
+            c_eid [e] = ceid [e];
+            c_from_lon [e] = lon [v];
+            c_from_lat [e] = lat [v];
+            c_to_lon [e] = lon [cto [e]];
+            c_to_lat [e] = lat [cto [e]];
+        }
+    Rcpp::List compact;
+    compact ["from_id"] = c_from;
+    compact ["to_id"] = c_to;
+    compact ["edge_id"] = c_eid;
+    compact ["d"] = Rcpp::NumericVector (cd, cd + nc);
+    for (size_t w = 0; w < weight_names.size (); w++)
+        compact [weight_names [w]] = Rcpp::NumericVector (cw + w * nc,
+                cw + (w + 1) * nc);
+    compact ["from_lat"] = c_from_lat;
+    compact ["from_lon"] = c_from_lon;
+    compact ["to_lat"] = c_to_lat;
+    compact ["to_lon"] = c_to_lon;
+    as_factor (c_hw, highways);
+    compact ["highway"] = c_hw;
+
+    // Original graph
+    const uint32_t *ofrom = cache.section <uint32_t> (gc_original_from);
+    const uint32_t *oto = cache.section <uint32_t> (gc_original_to);
+    const uint32_t *ohw = cache.section <uint32_t> (gc_original_highway);
+    const int32_t *oeid = cache.section <int32_t> (gc_original_edge_id);
+    const double *od = cache.section <double> (gc_original_d);
+    const double *ow = cache.section <double> (gc_original_weights);
+    Rcpp::NumericVector o_from (no), o_to (no);
+    Rcpp::IntegerVector o_hw (no);
+    Rcpp::NumericVector o_eid (no), o_from_lon (no), o_from_lat (no),
+        o_to_lon (no), o_to_lat (no);
+    for (size_t e = 0; e < no; e++)
+    {
+        o_from [e] = static_cast <double> (vid [ofrom [e]]);
+        o_to [e] = static_cast <double> (vid [oto [e]]);
+        o_hw [e] = static_cast <int> (ohw [e]) + 1;
+        o_eid [e] = oeid [e];
+        o_from_lon [e] = lon [ofrom [e]];
+        o_from_lat [e] = lat [ofrom [e]];
+        o_to_lon [e] = lon [oto [e]];
+        o_to_lat [e] = lat [oto [e]];
+    }
+    Rcpp::List original;
+    original ["edge_id"] = o_eid;
+    original ["from_id"] = o_from;
+    original ["from_lon"] = o_from_lon;
+    original ["from_lat"] = o_from_lat;
+    original ["to_id"] = o_to;
+    original ["to_lon"] = o_to_lon;
+    original ["to_lat"] = o_to_lat;
+    original ["d"] = Rcpp::NumericVector (od, od + no);
+    for (size_t w = 0; w < weight_names.size (); w++)
+        original [weight_names [w]] = Rcpp::NumericVector (ow + w * no,
+                ow + (w + 1) * no);
+    as_factor (o_hw, highways);
+    original ["highway"] = o_hw;
+
+    const int32_t *mc = cache.section <int32_t> (gc_map_compact);
+    const int32_t *mo = cache.section <int32_t> (gc_map_original);
+    Rcpp::List map;
+    map ["id_compact"] = Rcpp::NumericVector (mc, mc + h.nmap);
+    map ["id_original"] = Rcpp::NumericVector (mo, mo + h.nmap);
+
+    return Rcpp::List::create (
+            Rcpp::Named ("compact") = as_data_frame (compact, nc),
+            Rcpp::Named ("original") = as_data_frame (original, no),
+            Rcpp::Named ("map") = as_data_frame (map, h.nmap));
+}
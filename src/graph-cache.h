@@ -0,0 +1,146 @@
+/***************************************************************************
+ *  Project:    osmprob
+ *  File:       graph-cache.h
+ *  Language:   C++
+ *
+ *  osmprob is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  osmprob is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  osm-router.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Versioned binary files of compact graphs, their original
+ *                  graphs and the map between the two. Files consist of a
+ *                  fixed header followed by flat arrays, each aligned to 8
+ *                  bytes, so they are read in a single call and converted
+ *                  without any parsing.
+ *
+ *  Limitations:    Files are in native byte order, and are rejected by
+ *                  machines of the other order. Vertex and edge IDs must be
+ *                  integers, and edge IDs must fit in 32 bits. Loading copies
+ *                  every section into R vectors, so loaded graphs are not
+ *                  shared between processes.
+ *
+ *  Dependencies:       none (no Rcpp)
+ *
+ *  Compiler Options:   -std=c++11
+ ***************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <string>
+#include <vector>
+
+#include "graph-csr.h"
+
+// Incremented whenever the layout changes; older files are then rejected
+const uint32_t graph_cache_version = 1;
+const uint32_t graph_cache_byte_order = 0x01020304;
+
+struct graph_cache_header_t
+{
+    char magic [8];
+    uint32_t version, byte_order;
+    uint64_t nvertices, ncompact, noriginal, nmap;
+    // Number of weighting profiles, each with one weight per edge
+    uint64_t nweights;
+    // Highway types, then profile names, each NUL-terminated
+    uint64_t nhighways, strings_size;
+    uint64_t file_size;
+};
+
+/* Sections in file order. Vertices are indexed by position in vertex_id. The
+ * compact graph is in CSR form, with the out-edges of vertex v in
+ * [compact_offsets [v], compact_offsets [v + 1]); original edges are in
+ * their input order. Weights hold nweights consecutive arrays, one per
+ * profile. */
+enum graph_cache_section_t
+{
+    gc_vertex_id,           // int64 [nvertices]
+    gc_lon,                 // double [nvertices]
+    gc_lat,                 // double [nvertices]
+    gc_compact_offsets,     // uint32 [nvertices + 1]
+    gc_compact_to,          // uint32 [ncompact]
+    gc_compact_edge_id,     // int32 [ncompact]
+    gc_compact_d,           // double [ncompact]
+    gc_compact_weights,     // double [nweights * ncompact]
+    gc_compact_highway,     // uint32 [ncompact]
+    gc_original_from,       // uint32 [noriginal]
+    gc_original_to,         // uint32 [noriginal]
+    gc_original_edge_id,    // int32 [noriginal]
+    gc_original_d,          // double [noriginal]
+    gc_original_weights,    // double [nweights * noriginal]
+    gc_original_highway,    // uint32 [noriginal]
+    gc_map_compact,         // int32 [nmap]
+    gc_map_original,        // int32 [nmap]
+    gc_strings,             // char [strings_size]
+    gc_nsections
+};
+
+typedef std::array <size_t, gc_nsections + 1> graph_cache_layout_t;
+
+// Byte offsets of each section, and of the end of the file in the last entry
+graph_cache_layout_t graph_cache_layout (const graph_cache_header_t &h);
+
+// Everything held in a file, in the order of the file sections
+struct graph_cache_data_t
+{
+    std::vector <vertex_t> vertex_id;
+    std::vector <double> lon, lat;
+    std::vector <uint32_t> compact_offsets, compact_to, compact_highway;
+    std::vector <int32_t> compact_edge_id;
+    std::vector <double> compact_d, compact_weights;
+    std::vector <uint32_t> original_from, original_to, original_highway;
+    std::vector <int32_t> original_edge_id;
+    std::vector <double> original_d, original_weights;
+    std::vector <int32_t> map_compact, map_original;
+    std::vector <std::string> highways, weight_names;
+};
+
+void write_graph_cache (const std::string &filename,
+        const graph_cache_data_t &data);
+
+/* A file read into memory and validated on opening, so that section pointers
+ * may be used without further checks. */
+class GraphCache
+{
+    private:
+        const char *_data;
+        size_t _size;
+        std::vector <uint64_t> _buf;
+        graph_cache_layout_t _layout;
+
+        // Sets _layout
+        void validate ();
+
+    public:
+        GraphCache (const std::string &filename);
+        GraphCache (const GraphCache &) = delete;
+        GraphCache &operator= (const GraphCache &) = delete;
+
+        const graph_cache_header_t &header () const
+        {
+            return *reinterpret_cast <const graph_cache_header_t *> (_data);
+        }
+
+        template <typename T>
+        const T *section (graph_cache_section_t s) const
+        {
+            return reinterpret_cast <const T *> (_data + _layout [s]);
+        }
+
+        // Highway types then weight names, as stored in gc_strings
+        std::vector <std::string> strings () const;
+};
@@ -0,0 +1,116 @@
+/***************************************************************************
+ *  Project:    osmprob
+ *  File:       graph-csr.cpp
+ *  Language:   C++
+ *
+ *  osmprob is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  osmprob is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  osm-router.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Author:     Mark Padgham 
+ *  E-Mail:     mark.padgham@email.com 
+ *
+ *  Description:    Construction of CSR graphs from edge lists
+ *
+ *  Limitations:
+ *
+ *  Dependencies:       none
+ *
+ *  Compiler Options:   -std=c++11 
+ ***************************************************************************/
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "graph-csr.h"
+
+index_t csr_graph_t::vertex_index (vertex_t id) const
+{
+    auto it = index.find (id);
+    if (it == index.end ())
+        throw std::runtime_error ("vertex " + std::to_string (id) +
+                " is not part of the graph");
+    return it->second;
+}
+
+void csr_graph_t::build (const std::vector <vertex_t> &idfrom,
+        const std::vector <vertex_t> &idto,
+        const std::vector <weight_t> &w)
+{
+    const size_t nedges = idfrom.size ();
+    if (idto.size () != nedges || w.size () != nedges)
+        throw std::runtime_error ("edge vectors must all have the same length");
+
+    // The single sort pass: unique vertex IDs in ascending order
+    ids.resize (2 * nedges);
+    std::copy (idfrom.begin (), idfrom.end (), ids.begin ());
+    std::copy (idto.begin (), idto.end (), ids.begin () + nedges);
+    std::sort (ids.begin (), ids.end ());
+    ids.erase (std::unique (ids.begin (), ids.end ()), ids.end ());
+    ids.shrink_to_fit ();
+
+    index.clear ();
+    index.reserve (ids.size ());
+    for (index_t i = 0; i < ids.size (); i++)
+        index.emplace (ids [i], i);
+
+    // Counting sort of edges by dense index of the from vertex, which is
+    // stable and so retains input order within each vertex.
+    std::vector <index_t> from_index (nedges);
+    offsets.assign (ids.size () + 1, 0);
+    for (size_t i = 0; i < nedges; i++)
+    {
+        from_index [i] = index.find (idfrom [i])->second;
+        offsets [from_index [i] + 1]++;
+    }
+    for (index_t i = 0; i < ids.size (); i++)
+        offsets [i + 1] += offsets [i];
+
+    targets.resize (nedges);
+    weights.resize (nedges);
+    edge_index.resize (nedges);
+    std::vector <index_t> pos (offsets.begin (), offsets.end () - 1);
+    for (size_t i = 0; i < nedges; i++)
+    {
+        const index_t k = pos [from_index [i]]++;
+        targets [k] = index.find (idto [i])->second;
+        weights [k] = w [i];
+        edge_index [k] = i;
+    }
+}
+
+csr_graph_t csr_graph_t::reverse () const
+{
+    csr_graph_t rev;
+    const index_t n = nvertices ();
+    rev.offsets.assign (n + 1, 0);
+    for (index_t k = 0; k < nedges (); k++)
+        rev.offsets [targets [k] + 1]++;
+    for (index_t i = 0; i < n; i++)
+        rev.offsets [i + 1] += rev.offsets [i];
+
+    rev.targets.resize (nedges ());
+    rev.weights.resize (nedges ());
+    rev.edge_index.resize (nedges ());
+    std::vector <index_t> pos (rev.offsets.begin (), rev.offsets.end () - 1);
+    for (index_t u = 0; u < n; u++)
+        for (index_t k = offsets [u]; k < offsets [u + 1]; k++)
+        {
+            const index_t j = pos [targets [k]]++;
+            rev.targets [j] = u;
+            rev.weights [j] = weights [k];
+            rev.edge_index [j] = edge_index [k];
+        }
+
+    return rev;
+}
@@ -0,0 +1,144 @@
+/***************************************************************************
+ *  Project:    osmprob
+ *  File:       graph-csr.h
+ *  Language:   C++
+ *
+ *  osmprob is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  osmprob is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  osm-router.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Author:     Mark Padgham 
+ *  E-Mail:     mark.padgham@email.com 
+ *
+ *  Description:    Compressed sparse row (CSR) representation of a directed
+ *                  graph, with vertices re-indexed to [0, nvertices).
+ *
+ *  Limitations:
+ *
+ *  Dependencies:       none (no Rcpp, so usable from threaded code)
+ *
+ *  Compiler Options:   -std=c++11 
+ ***************************************************************************/
+
+#pragma once
+
+#include <cerrno>
+#include <cstdlib>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <stdexcept>
+
+typedef long long vertex_t;
+typedef double weight_t;
+typedef unsigned int index_t;
+
+/* The out-edges of dense vertex u are the entries [offsets [u], offsets [u + 1])
+ * of targets and weights. edge_index holds the position of each CSR entry in
+ * the edge list from which the graph was built, so that per-edge results can be
+ * returned in the original order. Within each vertex, edges retain their input
+ * order. */
+struct csr_graph_t
+{
+    std::vector <index_t> offsets, targets, edge_index;
+    std::vector <weight_t> weights;
+    // Dense index -> vertex ID, sorted ascending
+    std::vector <vertex_t> ids;
+    // Vertex ID -> dense index
+    std::unordered_map <vertex_t, index_t> index;
+
+    index_t nvertices () const
+    {
+        return offsets.empty () ? 0 : offsets.size () - 1;
+    }
+    index_t nedges () const { return targets.size (); }
+
+    bool has_vertex (vertex_t id) const
+    {
+        return index.find (id) != index.end ();
+    }
+    index_t vertex_index (vertex_t id) const;
+
+    void build (const std::vector <vertex_t> &idfrom,
+            const std::vector <vertex_t> &idto,
+            const std::vector <weight_t> &w);
+    // The transposed graph, with edge_index pointing at the same input edges.
+    // ids and index are not copied.
+    csr_graph_t reverse () const;
+};
+
+/* Character vertex IDs, as held in R data.frames, interned to consecutive
+ * vertex_t values in order of first appearance. */
+struct string_ids_t
+{
+    std::vector <std::string> names;
+    std::unordered_map <std::string, vertex_t> index;
+
+    vertex_t intern (const std::string &id)
+    {
+        auto it = index.emplace (id, names.size ());
+        if (it.second)
+            names.push_back (id);
+        return it.first->second;
+    }
+
+    bool has (const std::string &id) const
+    {
+        return index.find (id) != index.end ();
+    }
+
+    vertex_t at (const std::string &id) const
+    {
+        auto it = index.find (id);
+        if (it == index.end ())
+            throw std::runtime_error ("vertex " + id +
+                    " is not part of the graph");
+        return it->second;
+    }
+};
+
+/* Integer (OSM) vertex IDs interned to consecutive index_t values in order of
+ * first appearance, for graphs too large for string_ids_t. */
+struct vertex_ids_t
+{
+    std::vector <vertex_t> ids;
+    std::unordered_map <vertex_t, index_t> index;
+
+    index_t intern (vertex_t id)
+    {
+        auto it = index.emplace (id, static_cast <index_t> (ids.size ()));
+        if (it.second)
+            ids.push_back (id);
+        return it.first->second;
+    }
+
+    index_t size () const { return ids.size (); }
+};
+
+// Integer vertex ID from its character representation, as held in R, or false
+// if c is not an integer within range
+inline bool parse_vertex_id (const char *c, vertex_t &v)
+{
+    char *end;
+    errno = 0;
+    v = std::strtoll (c, &end, 10);
+    return end != c && *end == '\0' && errno != ERANGE;
+}
+
+inline vertex_t parse_vertex_id (const char *c)
+{
+    vertex_t v;
+    if (!parse_vertex_id (c, v))
+        throw std::runtime_error (std::string ("vertex ID ") + c +
+                " is not an integer");
+    return v;
+}
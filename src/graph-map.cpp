@@ -0,0 +1,215 @@
+/***************************************************************************
+ *  Project:    osmprob
+ *  File:       graph-map.cpp
+ *  Language:   C++
+ *
+ *  osmprob is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  osmprob is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  osm-router.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Expansion of paths and per-edge values from compact graphs
+ *                  on to their original graphs.
+ *
+ *  Limitations:
+ *
+ *  Dependencies:       none
+ *
+ *  Compiler Options:   -std=c++11
+ ***************************************************************************/
+
+#include <unordered_map>
+
+#include <Rcpp.h>
+
+#include "graph-map.h"
+
+void edge_expansion_t::build (const std::vector <vertex_t> &compact_edge_id,
+        const std::vector <vertex_t> &original_edge_id,
+        const std::vector <vertex_t> &map_compact,
+        const std::vector <vertex_t> &map_original)
+{
+    if (map_compact.size () != map_original.size ())
+        throw std::runtime_error ("map must have the same number of compact "
+                "and original edges");
+
+    const index_t ncompact = compact_edge_id.size (),
+          noriginal = original_edge_id.size ();
+    std::unordered_map <vertex_t, index_t> compact_index, original_index;
+    compact_index.reserve (ncompact);
+    for (index_t i = 0; i < ncompact; i++)
+        compact_index.emplace (compact_edge_id [i], i);
+    original_index.reserve (noriginal);
+    for (index_t i = 0; i < noriginal; i++)
+        original_index.emplace (original_edge_id [i], i);
+
+    // Map entries as (compact row, original row), skipping any edges which
+    // are in neither graph
+    std::vector <index_t> map_from, map_to;
+    map_from.reserve (map_compact.size ());
+    map_to.reserve (map_compact.size ());
+    for (size_t i = 0; i < map_compact.size (); i++)
+    {
+        auto c = compact_index.find (map_compact [i]);
+        auto o = original_index.find (map_original [i]);
+        if (c != compact_index.end () && o != original_index.end ())
+        {
+            map_from.push_back (c->second);
+            map_to.push_back (o->second);
+        }
+    }
+
+    // Compact edges without map entries are their own original edges
+    std::vector <index_t> nmapped (ncompact, 0);
+    for (auto c: map_from)
+        nmapped [c]++;
+    for (index_t i = 0; i < ncompact; i++)
+        if (nmapped [i] == 0)
+        {
+            auto o = original_index.find (compact_edge_id [i]);
+            if (o != original_index.end ())
+            {
+                map_from.push_back (i);
+                map_to.push_back (o->second);
+                nmapped [i]++;
+            }
+        }
+
+    // Counting sort of map entries by compact row, which retains their order
+    // along each compact edge
+    offsets.assign (ncompact + 1, 0);
+    for (index_t i = 0; i < ncompact; i++)
+        offsets [i + 1] = offsets [i] + nmapped [i];
+    rows.resize (map_from.size ());
+    compact_row.assign (noriginal, no_edge);
+    std::vector <index_t> pos (offsets.begin (), offsets.end () - 1);
+    for (size_t i = 0; i < map_from.size (); i++)
+    {
+        rows [pos [map_from [i]]++] = map_to [i];
+        compact_row [map_to [i]] = map_from [i];
+    }
+}
+
+void edge_expansion_t::expand (const std::vector <index_t> &compact_rows,
+        std::vector <index_t> &original_rows) const
+{
+    for (auto c: compact_rows)
+        original_rows.insert (original_rows.end (), rows.begin () + offsets [c],
+                rows.begin () + offsets [c + 1]);
+}
+
+// Compact rows joining consecutive vertices of path, taking the lightest of
+// any parallel edges
+std::vector <index_t> compact_path_rows (Rcpp::DataFrame compact,
+        const std::vector <std::string> &path)
+{
+    Rcpp::CharacterVector idfrom = compact ["from_id"];
+    Rcpp::CharacterVector idto = compact ["to_id"];
+    Rcpp::NumericVector w = compact ["d_weighted"];
+
+    string_ids_t ids;
+    for (auto p: path)
+        ids.intern (p);
+    // Keyed on (from, to) pairs of interned path vertices
+    const vertex_t n = ids.names.size ();
+    std::unordered_map <vertex_t, index_t> segment_row;
+    for (size_t i = 1; i < path.size (); i++)
+        segment_row.emplace (ids.at (path [i - 1]) * n + ids.at (path [i]),
+                no_edge);
+
+    for (int r = 0; r < idfrom.size (); r++)
+    {
+        const std::string f (idfrom [r]), t (idto [r]);
+        if (!ids.has (f) || !ids.has (t))
+            continue;
+        auto s = segment_row.find (ids.at (f) * n + ids.at (t));
+        if (s != segment_row.end () &&
+                (s->second == no_edge || w [r] < w [s->second]))
+            s->second = r;
+    }
+
+    std::vector <index_t> rows (path.empty () ? 0 : path.size () - 1);
+    for (size_t i = 1; i < path.size (); i++)
+    {
+        rows [i - 1] = segment_row.find (ids.at (path [i - 1]) * n +
+                ids.at (path [i]))->second;
+        if (rows [i - 1] == no_edge)
+            throw std::runtime_error ("path from " + path [i - 1] + " to " +
+                    path [i] + " is not part of the compact graph");
+    }
+    return rows;
+}
+
+//' rcpp_expand_path
+//'
+//' Edges of the original graph along a path through the compact graph
+//'
+//' @param compact Compact graph, with columns \code{from_id}, \code{to_id},
+//' \code{edge_id} and \code{d_weighted}
+//' @param original_edge_id Edge IDs of the original graph
+//' @param map_compact Compact edge IDs of the map between the two graphs
+//' @param map_original Original edge IDs of the map between the two graphs
+//' @param path IDs of vertices of the compact graph along the path
+//'
+//' @return (1-based) rows of the original graph along the path, in order
+//'
+//' @noRd
+// [[Rcpp::export]]
+Rcpp::IntegerVector rcpp_expand_path (Rcpp::DataFrame compact,
+        std::vector <double> original_edge_id, std::vector <double> map_compact,
+        std::vector <double> map_original, std::vector <std::string> path)
+{
+    Rcpp::NumericVector compact_edge_id = compact ["edge_id"];
+    edge_expansion_t expansion;
+    expansion.build (as_edge_ids (Rcpp::as <std::vector <double> >
+                (compact_edge_id)), as_edge_ids (original_edge_id),
+            as_edge_ids (map_compact), as_edge_ids (map_original));
+
+    std::vector <index_t> rows;
+    expansion.expand (compact_path_rows (compact, path), rows);
+
+    Rcpp::IntegerVector res (rows.size ());
+    for (size_t i = 0; i < rows.size (); i++)
+        res [i] = rows [i] + 1;
+    return res;
+}
+
+//' rcpp_original_to_compact
+//'
+//' Edges of the compact graph which replace each edge of the original graph
+//'
+//' @param compact_edge_id Edge IDs of the compact graph
+//' @inheritParams rcpp_expand_path
+//'
+//' @return (1-based) row of the compact graph for each row of the original
+//' graph, or \code{NA} for original edges not part of the compact graph
+//'
+//' @noRd
+// [[Rcpp::export]]
+Rcpp::IntegerVector rcpp_original_to_compact (
+        std::vector <double> compact_edge_id,
+        std::vector <double> original_edge_id, std::vector <double> map_compact,
+        std::vector <double> map_original)
+{
+    edge_expansion_t expansion;
+    expansion.build (as_edge_ids (compact_edge_id),
+            as_edge_ids (original_edge_id), as_edge_ids (map_compact),
+            as_edge_ids (map_original));
+
+    Rcpp::IntegerVector res (expansion.compact_row.size ());
+    for (size_t i = 0; i < expansion.compact_row.size (); i++)
+        res [i] = expansion.compact_row [i] == no_edge ? NA_INTEGER :
+            expansion.compact_row [i] + 1;
+    return res;
+}
@@ -0,0 +1,84 @@
+/***************************************************************************
+ *  Project:    osmprob
+ *  File:       graph-map.h
+ *  Language:   C++
+ *
+ *  osmprob is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  osmprob is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  osm-router.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Expansion of edges of compact graphs into the edges of the
+ *                  original graphs which they replace, indexed once so that
+ *                  paths and per-edge values are mapped in time proportional
+ *                  to their size.
+ *
+ *  Limitations:    Edge IDs must be integers of at most 2^53 in magnitude.
+ *
+ *  Dependencies:       none (no Rcpp)
+ *
+ *  Compiler Options:   -std=c++11
+ ***************************************************************************/
+
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <stdexcept>
+
+#include "graph-csr.h"
+
+const index_t no_edge = std::numeric_limits <index_t>::max ();
+
+// Edge IDs, which R holds as doubles, and so as exact integers only up to
+// 2^53
+inline std::vector <vertex_t> as_edge_ids (const std::vector <double> &id)
+{
+    const double max_id = 9007199254740992.0;
+    std::vector <vertex_t> ids (id.size ());
+    for (size_t i = 0; i < id.size (); i++)
+    {
+        // Checked before casting, as casting an out-of-range double is
+        // undefined; NaN fails both comparisons
+        if (!(id [i] >= -max_id && id [i] <= max_id) ||
+                id [i] != std::floor (id [i]))
+            throw std::runtime_error ("edge IDs must be integers");
+        ids [i] = static_cast <vertex_t> (id [i]);
+    }
+    return ids;
+}
+
+/* Rows of the original graph replaced by each row of the compact graph, as
+ * given by the map (id_compact, id_original) of rcpp_make_compact_graph.
+ * Compact edges which are not in the map replace only the original edge with
+ * the same ID. All indices are rows of the respective data.frames. */
+struct edge_expansion_t
+{
+    // Original rows of compact row i, in order along the edge, are
+    // rows [offsets [i], offsets [i + 1])
+    std::vector <index_t> offsets, rows;
+    // Compact row of each original row, or no_edge for original edges which
+    // are not part of the compact graph
+    std::vector <index_t> compact_row;
+
+    void build (const std::vector <vertex_t> &compact_edge_id,
+            const std::vector <vertex_t> &original_edge_id,
+            const std::vector <vertex_t> &map_compact,
+            const std::vector <vertex_t> &map_original);
+
+    // Append the original rows of each of compact_rows, in order
+    void expand (const std::vector <index_t> &compact_rows,
+            std::vector <index_t> &original_rows) const;
+};
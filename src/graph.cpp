@@ -1,315 +1,438 @@
 #include <Rcpp.h>
 #include <algorithm>
 #include <vector>
-#include <map>
+#include <atomic>
+#include <memory>
 
-typedef std::string osm_id_t;
-typedef int osm_edge_id_t;
+#include "graph-csr.h"
+#include "instrument.h"
+#include "network-columns.h"
+#include "parallel.h"
 
-struct osm_vertex_t
-{
-    private:
-        std::unordered_set <osm_id_t> in, out;
-        double lat, lon;
-
-    public:
-        void add_neighbour_in (osm_id_t osm_id) { in.insert (osm_id); }
-        void add_neighbour_out (osm_id_t osm_id) { out.insert (osm_id); }
-        int get_degree_in () { return in.size (); }
-        int get_degree_out () { return out.size (); }
-
-        void set_lat (double lat) { this -> lat = lat; }
-        void set_lon (double lon) { this -> lon = lon; }
-        double getLat () { return lat; }
-        double getLon () { return lon; }
-
-        std::unordered_set <osm_id_t> get_all_neighbours ()
-        {
-            std::unordered_set <osm_id_t> all_neighbours = in;
-            all_neighbours.insert (out.begin (), out.end ());
-            return all_neighbours;
-        }
+// Edges or vertices per parallel block of union-find operations
+const size_t uf_block_size = 1 << 14;
 
-        void replace_neighbour (osm_id_t n_old, osm_id_t n_new)
-        {
-            if (in.find (n_old) != in.end ())
-            {
-                in.erase (n_old);
-                in.insert (n_new);
-            }
-            if (out.find (n_old) != out.end ())
-            {
-                out.erase (n_old);
-                out.insert (n_new);
-            }
-        }
+/* The graph as flat arrays. Vertices are identified throughout by their dense
+ * index, interned from the 64-bit OSM IDs of the input (see vertex_ids_t), and
+ * converted back to OSM IDs only for the returned data.frame. */
+struct osm_graph_t
+{
+    vertex_ids_t ids;
+    // Per vertex
+    std::vector <double> lon, lat;
+    // Per edge, with highway indexing highways
+    std::vector <index_t> from, to, highway;
+    std::vector <double> dist, weight;
+    std::vector <int> edge_id;
+    std::vector <std::string> highways;
+
+    index_t nvertices () const { return ids.size (); }
+    index_t nedges () const { return from.size (); }
+    index_t other (index_t e, index_t v) const
+    {
+        return from [e] == v ? to [e] : from [e];
+    }
+};
 
-        bool is_intermediate_single ()
-        {
-            return (in.size () == 1 && out.size () == 1 &&
-                    get_all_neighbours ().size () == 2);
-        }
+/* The edges incident to each vertex in either direction, with those of vertex
+ * v in edges [offsets [v], offsets [v + 1]), ordered by edge. */
+struct incidence_t
+{
+    std::vector <index_t> offsets, edges;
 
-        bool is_intermediate_double ()
-        {
-            return (in.size () == 2 && out.size () == 2 &&
-                    get_all_neighbours ().size () == 2);
-        }
+    index_t degree (index_t v) const { return offsets [v + 1] - offsets [v]; }
 };
 
-struct osm_edge_t
+struct compact_graph_t
 {
-    private:
-        osm_id_t from, to;
-        osm_edge_id_t id;
-        std::set <int> contracted_edges;
-        bool in_original_graph;
-
-    public:
-        float dist;
-        float weight;
-        bool replaced_by_compact = false;
-        std::string highway;
-
-        osm_id_t get_from_vertex () { return from; }
-        osm_id_t get_to_vertex () { return to; }
-        osm_edge_id_t getID () { return id; }
-        std::set <int> is_replacement_for () { return contracted_edges; }
-        bool in_original () { return in_original_graph; }
-
-        osm_edge_t (osm_id_t from_id, osm_id_t to_id, float dist, float weight,
-                   std::string highway, int id, std::set <int> replacement_edges)
-        {
-            this -> to = to_id;
-            this -> from = from_id;
-            this -> dist = dist;
-            this -> weight = weight;
-            this -> highway = highway;
-            this -> id = id;
-            this -> contracted_edges.insert (replacement_edges.begin (),
-                    replacement_edges.end ());
-        }
+    std::vector <index_t> from, to, highway;
+    std::vector <double> dist, weight;
+    std::vector <int> edge_id;
+    /* (compact, original) edge ID pairs for each contracted edge, with the
+     * original edges in order along the compact one. Edges which are retained
+     * as they are keep their original IDs and are not in the map. */
+    std::vector <int> map_compact, map_original;
+
+    void add_edge (index_t f, index_t t, index_t hw, double d, double w,
+            int id)
+    {
+        from.push_back (f);
+        to.push_back (t);
+        highway.push_back (hw);
+        dist.push_back (d);
+        weight.push_back (w);
+        edge_id.push_back (id);
+    }
 };
 
-typedef std::unordered_map <osm_id_t, osm_vertex_t> vertex_map_t;
-typedef std::unordered_map <int, osm_edge_t> edge_map_t;
-typedef std::unordered_map <osm_id_t, std::set <int>> vert2edge_map_t;
-
-void add_to_edge_map (vert2edge_map_t &vert2edge_map, osm_id_t vid, int eid)
+void build_incidence (const osm_graph_t &g, incidence_t &inc)
 {
-    std::set <int> edge_ids;
-    if (vert2edge_map.find (vid) == vert2edge_map.end ())
+    const index_t nv = g.nvertices (), ne = g.nedges ();
+    inc.offsets.assign (nv + 1, 0);
+    for (index_t e = 0; e < ne; e++)
     {
-        edge_ids.insert (eid);
-        vert2edge_map.emplace (vid, edge_ids);
-    } else
+        inc.offsets [g.from [e] + 1]++;
+        if (g.to [e] != g.from [e])
+            inc.offsets [g.to [e] + 1]++;
+    }
+    for (index_t v = 0; v < nv; v++)
+        inc.offsets [v + 1] += inc.offsets [v];
+
+    inc.edges.resize (inc.offsets [nv]);
+    std::vector <index_t> pos (inc.offsets.begin (), inc.offsets.end () - 1);
+    for (index_t e = 0; e < ne; e++)
     {
-        edge_ids = vert2edge_map [vid];
-        edge_ids.insert (eid);
-        vert2edge_map [vid] = edge_ids;
+        inc.edges [pos [g.from [e]]++] = e;
+        if (g.to [e] != g.from [e])
+            inc.edges [pos [g.to [e]]++] = e;
     }
 }
 
-void erase_from_edge_map (vert2edge_map_t &vert2edge_map, osm_id_t vid, int eid)
+/* Intermediate vertices lie within a one-way (A -> v -> B) or two-way
+ * (A <-> v <-> B) sequence of edges, with no other edges, and can be removed
+ * by joining their edges. */
+void find_intermediate_vertices (const osm_graph_t &g, const incidence_t &inc,
+        std::vector <char> &intermediate)
 {
-    std::set <int> edge_ids = vert2edge_map [vid];
-    if (edge_ids.find (eid) != edge_ids.end ())
+    const index_t nv = g.nvertices ();
+    intermediate.assign (nv, 0);
+    // Neighbours already counted for vertex v are marked with v + 1
+    std::vector <index_t> seen_in (nv, 0), seen_out (nv, 0), seen_all (nv, 0);
+    for (index_t v = 0; v < nv; v++)
     {
-        edge_ids.erase (eid);
-        vert2edge_map [vid] = edge_ids;
+        int n_in = 0, n_out = 0, n_all = 0;
+        for (index_t k = inc.offsets [v]; k < inc.offsets [v + 1]; k++)
+        {
+            const index_t e = inc.edges [k];
+            const index_t u = g.other (e, v);
+            if (g.to [e] == v && seen_in [u] != v + 1)
+            {
+                seen_in [u] = v + 1;
+                n_in++;
+            }
+            if (g.from [e] == v && seen_out [u] != v + 1)
+            {
+                seen_out [u] = v + 1;
+                n_out++;
+            }
+            if (seen_all [u] != v + 1)
+            {
+                seen_all [u] = v + 1;
+                n_all++;
+            }
+        }
+        const index_t ne = inc.degree (v);
+        intermediate [v] = n_all == 2 &&
+            ((n_in == 1 && n_out == 1 && ne == 2) ||
+             (n_in == 2 && n_out == 2 && ne == 4));
     }
 }
 
-void graph_from_df (Rcpp::DataFrame gr, vertex_map_t &vm,
-        edge_map_t &edge_map, vert2edge_map_t &vert2edge_map)
+// Lock-free union-find, with roots always linked to the smaller root, so that
+// each component ends up labelled by its smallest vertex.
+inline index_t uf_find (std::vector <std::atomic <index_t> > &parent,
+        index_t v)
 {
-    Rcpp::StringVector from = gr ["from_id"];
-    Rcpp::StringVector to = gr ["to_id"];
-    Rcpp::NumericVector from_lon = gr ["from_lon"];
-    Rcpp::NumericVector from_lat = gr ["from_lat"];
-    Rcpp::NumericVector to_lon = gr ["to_lon"];
-    Rcpp::NumericVector to_lat = gr ["to_lat"];
-    Rcpp::NumericVector edge_id = gr ["edge_id"];
-    Rcpp::NumericVector dist = gr ["d"];
-    Rcpp::NumericVector weight = gr ["d_weighted"];
-    Rcpp::StringVector hw = gr ["highway"];
+    while (true)
+    {
+        index_t p = parent [v].load ();
+        if (p == v)
+            return v;
+        // Path halving
+        const index_t gp = parent [p].load ();
+        if (gp != p)
+            parent [v].compare_exchange_weak (p, gp);
+        v = gp;
+    }
+}
 
-    for (int i = 0; i < to.length (); i ++)
+inline void uf_unite (std::vector <std::atomic <index_t> > &parent,
+        index_t a, index_t b)
+{
+    while (true)
     {
-        osm_id_t from_id = std::string (from [i]);
-        osm_id_t to_id = std::string (to [i]);
+        a = uf_find (parent, a);
+        b = uf_find (parent, b);
+        if (a == b)
+            return;
+        if (a < b)
+            std::swap (a, b);
+        index_t expected = a;
+        if (parent [a].compare_exchange_strong (expected, b))
+            return;
+    }
+}
 
-        if (vm.find (from_id) == vm.end ())
-        {
-            osm_vertex_t fromV = osm_vertex_t ();
-            fromV.set_lat (from_lat [i]);
-            fromV.set_lon (from_lon [i]);
-            vm.emplace (from_id, fromV);
-        }
-        osm_vertex_t from_vtx = vm.at (from_id);
-        from_vtx.add_neighbour_out (to_id);
-        vm [from_id] = from_vtx;
+/* Weakly connected components, by union-find over the edge list in parallel
+ * blocks of edges. com holds the component of each vertex, labelled by its
+ * smallest vertex, and largest the label of the largest component. */
+void get_largest_graph_component (const osm_graph_t &g,
+        std::vector <index_t> &com, index_t &largest)
+{
+    const index_t nv = g.nvertices (), ne = g.nedges ();
+    std::vector <std::atomic <index_t> > parent (nv);
+    for (index_t v = 0; v < nv; v++)
+        parent [v].store (v);
 
-        if (vm.find (to_id) == vm.end ())
-        {
-            osm_vertex_t toV = osm_vertex_t ();
-            toV.set_lat (to_lat [i]);
-            toV.set_lon (to_lon [i]);
-            vm.emplace (to_id, toV);
-        }
-        osm_vertex_t to_vtx = vm.at (to_id);
-        to_vtx.add_neighbour_in (from_id);
-        vm [to_id] = to_vtx;
-
-        std::set <int> replacementEdges;
-        osm_edge_t edge = osm_edge_t (from_id, to_id, dist [i], weight [i],
-                std::string (hw [i]), edge_id [i], replacementEdges);
-        edge_map.emplace (edge_id [i], edge);
-        add_to_edge_map (vert2edge_map, from_id, edge_id [i]);
-        add_to_edge_map (vert2edge_map, to_id, edge_id [i]);
+    const size_t nblocks = (ne + uf_block_size - 1) / uf_block_size;
+    parallel_for (nblocks, [&] (size_t b, int)
+    {
+        const size_t end = std::min (static_cast <size_t> (ne),
+                (b + 1) * uf_block_size);
+        for (size_t e = b * uf_block_size; e < end; e++)
+            uf_unite (parent, g.from [e], g.to [e]);
+    });
+
+    com.resize (nv);
+    const size_t nvblocks = (nv + uf_block_size - 1) / uf_block_size;
+    parallel_for (nvblocks, [&] (size_t b, int)
+    {
+        const size_t end = std::min (static_cast <size_t> (nv),
+                (b + 1) * uf_block_size);
+        for (size_t v = b * uf_block_size; v < end; v++)
+            com [v] = uf_find (parent, v);
+    });
+
+    std::vector <index_t> comp_sizes (nv, 0);
+    largest = 0;
+    for (index_t v = 0; v < nv; v++)
+        if (++comp_sizes [com [v]] > comp_sizes [largest])
+            largest = com [v];
+}
+
+// Remove all edges outside the given component
+void filter_graph_component (osm_graph_t &g, const std::vector <index_t> &com,
+        index_t component)
+{
+    index_t n = 0;
+    for (index_t e = 0; e < g.nedges (); e++)
+    {
+        if (com [g.from [e]] != component)
+            continue;
+        g.from [n] = g.from [e];
+        g.to [n] = g.to [e];
+        g.highway [n] = g.highway [e];
+        g.dist [n] = g.dist [e];
+        g.weight [n] = g.weight [e];
+        g.edge_id [n] = g.edge_id [e];
+        n++;
     }
+    g.from.resize (n);
+    g.to.resize (n);
+    g.highway.resize (n);
+    g.dist.resize (n);
+    g.weight.resize (n);
+    g.edge_id.resize (n);
 }
 
-void get_largest_graph_component (vertex_map_t &v,
-        std::unordered_map <osm_id_t, int> &com,
-        int &largest_id)
+/* Join the edges along chain [0] ... chain [n - 1], of which all but the end
+ * vertices are intermediate, into one compact edge in each direction in which
+ * they are traversable. */
+void join_chain (const osm_graph_t &g, const incidence_t &inc,
+        const std::vector <char> &intermediate,
+        const std::vector <index_t> &chain, int &next_edge_id,
+        std::vector <index_t> &chain_edges, compact_graph_t &cg)
 {
-    // initialize components map
-    for (auto it = v.begin (); it != v.end (); ++ it)
-        com.insert (std::make_pair (it -> first, -1));
-
-    std::unordered_set <osm_id_t> all_verts, component, nbs_todo, nbs_done;
-    for (auto it = v.begin (); it != v.end (); ++ it)
-        all_verts.insert (it -> first);
-    osm_id_t vt = (*all_verts.begin ());
-    nbs_todo.insert (vt);
-    int compnum = 0;
-    while (all_verts.size () > 0)
+    for (int dir = 0; dir < 2; dir++)
     {
-        vt = (*nbs_todo.begin ());
-        component.insert (vt);
-        com.at (vt) = compnum;
-        all_verts.erase (vt);
-
-        osm_vertex_t vtx = v.find (vt)->second;
-        std::unordered_set <osm_id_t> nbs = vtx.get_all_neighbours ();
-        for (auto n: nbs)
+        chain_edges.clear ();
+        for (size_t i = 1; i < chain.size (); i++)
         {
-            component.insert (n);
-            com.at (n) = compnum;
-            if (nbs_done.find (n) == nbs_done.end ())
-                nbs_todo.insert (n);
+            const index_t a = dir == 0 ? chain [i - 1] : chain [i];
+            const index_t b = dir == 0 ? chain [i] : chain [i - 1];
+            // Intermediate vertices have at most one edge a -> b
+            const index_t v = intermediate [a] ? a : b;
+            for (index_t k = inc.offsets [v]; k < inc.offsets [v + 1]; k++)
+            {
+                const index_t e = inc.edges [k];
+                if (g.from [e] == a && g.to [e] == b)
+                {
+                    chain_edges.push_back (e);
+                    break;
+                }
+            }
+            if (chain_edges.size () < i)
+                break;
         }
-        nbs_done.insert (vt);
-        nbs_todo.erase (vt);
+        if (chain_edges.size () < chain.size () - 1)
+            continue;
+        if (dir == 1)
+            std::reverse (chain_edges.begin (), chain_edges.end ());
 
-        if (nbs_todo.size () == 0 && all_verts.size () > 0)
+        double d = 0.0, w = 0.0;
+        for (auto e: chain_edges)
         {
-            nbs_todo.insert (*all_verts.begin ());
-            compnum++;
+            d += g.dist [e];
+            w += g.weight [e];
+            cg.map_compact.push_back (next_edge_id);
+            cg.map_original.push_back (g.edge_id [e]);
         }
+        // NOTE: There is no check that types of highways are consistent!
+        cg.add_edge (g.from [chain_edges.front ()], g.to [chain_edges.back ()],
+                g.highway [chain_edges.front ()], d, w, next_edge_id++);
     }
-
-    std::vector <int> comp_sizes (compnum, 0);
-    for (auto c: com)
-        comp_sizes [c.second]++;
-    auto maxi = std::max_element (comp_sizes.begin (), comp_sizes.end ());
-    largest_id = std::distance (comp_sizes.begin (), maxi);
-    //int maxsize = comp_sizes [largest_id];
 }
 
-
-void contract_graph (vertex_map_t &vertex_map, edge_map_t &edge_map,
-        vert2edge_map_t &vert2edge_map)
+/* Remove all intermediate vertices in a single pass, in O(V + E), by walking
+ * each chain of intermediate vertices between the vertices which are kept.
+ * Edges between kept vertices are retained as they are. Chains which would
+ * return to their starting vertex, including rings of intermediate vertices
+ * only, are split at an anchor vertex which is kept, so that no compact edge
+ * is a loop. New edges are numbered from one more than the largest original
+ * edge ID, and the compact edges are ordered by ID. */
+void contract_graph (const osm_graph_t &g, compact_graph_t &cg)
 {
-    std::unordered_set <osm_id_t> verts;
-    for (auto v: vertex_map)
-        verts.insert (v.first);
-
-    int max_edge_id = 0;
-    for (auto e: edge_map)
-        if (e.second.getID () > max_edge_id)
-            max_edge_id = e.second.getID ();
-    max_edge_id++;
-
-    std::set <int> edges_to_erase;
-
-    while (verts.size () > 0)
+    const index_t nv = g.nvertices ();
+    incidence_t inc;
+    build_incidence (g, inc);
+    std::vector <char> intermediate;
+    find_intermediate_vertices (g, inc, intermediate);
+
+    int next_edge_id = 0;
+    for (auto id: g.edge_id)
+        next_edge_id = std::max (next_edge_id, id);
+    next_edge_id++;
+
+    // Intermediate vertices already walked
+    std::vector <char> visited (nv, 0);
+    std::vector <index_t> todo;
+    for (index_t v = 0; v < nv; v++)
+        if (!intermediate [v])
+            todo.push_back (v);
+
+    std::vector <index_t> chain, chain_edges;
+    size_t next = 0;
+    index_t ring_start = 0;
+    while (true)
     {
-        std::unordered_set <osm_id_t>::iterator vid = verts.begin ();
-        osm_id_t vtx_id = vertex_map.find (*vid)->first;
-        osm_vertex_t vtx = vertex_map.find (*vid)->second;
-        std::set <int> edges = vert2edge_map [vtx_id];
+        if (next == todo.size ())
+        {
+            // Any intermediate vertices left are on rings
+            while (ring_start < nv &&
+                    (!intermediate [ring_start] || visited [ring_start]))
+                ring_start++;
+            if (ring_start == nv)
+                break;
+            intermediate [ring_start] = 0;
+            todo.push_back (ring_start);
+        }
 
-        if ((vtx.is_intermediate_single () || vtx.is_intermediate_double ()) &&
-                (edges.size () == 2 || edges.size () == 4))
+        const index_t s = todo [next++];
+        for (index_t k = inc.offsets [s]; k < inc.offsets [s + 1]; k++)
         {
-            // remove intervening vertex:
-            auto nbs = vtx.get_all_neighbours (); // unordered_set <osm_id_t>
-            std::vector <osm_id_t> two_nbs;
-            for (osm_id_t nb: nbs)
-                two_nbs.push_back (nb);
-
-            osm_vertex_t vt_from = vertex_map [two_nbs [0]],
-                vt_to = vertex_map [two_nbs [1]];
-
-            vt_from.replace_neighbour (vtx_id, two_nbs [1]);
-            vt_to.replace_neighbour (vtx_id, two_nbs [0]);
-            vertex_map [two_nbs [0]] = vt_from;
-            vertex_map [two_nbs [1]] = vt_to;
-
-            vertex_map.erase (vtx_id);
-
-            // construct new edge and remove old ones
-            float d_to = 0.0, d_from = 0.0, wt_to = 0.0, wt_from = 0.0;
-            std::set <int> replacement_edges;
-            replacement_edges.clear ();
-            std::string hw;
-            for (int e: edges)
+            const index_t e = inc.edges [k];
+            const index_t n = g.other (e, s);
+            if (!intermediate [n])
             {
-                replacement_edges.insert (e);
-                osm_edge_t ei = edge_map.find (e)->second;
-                // NOTE: There is no check that types of highways are consistent!
-                hw = ei.highway;
-                if (ei.get_from_vertex () == two_nbs [0] ||
-                        ei.get_to_vertex () == two_nbs [1])
-                {
-                    d_to += ei.dist;
-                    wt_to += ei.weight;
-                } else if (ei.get_from_vertex () == two_nbs [1] ||
-                        ei.get_to_vertex () == two_nbs [0])
-                {
-                    d_from += ei.dist;
-                    wt_from += ei.weight;
-                }
-                edges_to_erase.insert (e);
-                erase_from_edge_map (vert2edge_map, two_nbs [0], e);
-                erase_from_edge_map (vert2edge_map, two_nbs [1], e);
+                // Retained edges are added once, from their from vertex
+                if (g.from [e] == s)
+                    cg.add_edge (s, n, g.highway [e], g.dist [e],
+                            g.weight [e], g.edge_id [e]);
+                continue;
             }
+            if (visited [n])
+                continue;
 
-            if (d_to > 0.0)
+            chain.clear ();
+            chain.push_back (s);
+            index_t prev = s, cur = n;
+            while (intermediate [cur])
             {
-                osm_edge_t new_edge = osm_edge_t (two_nbs [0], two_nbs [1],
-                        d_to, wt_to, hw, max_edge_id, replacement_edges);
-                add_to_edge_map (vert2edge_map, two_nbs [0], max_edge_id);
-                add_to_edge_map (vert2edge_map, two_nbs [1], max_edge_id);
-                edge_map.emplace (max_edge_id++, new_edge);
+                chain.push_back (cur);
+                visited [cur] = 1;
+                index_t nxt = prev;
+                for (index_t k2 = inc.offsets [cur]; k2 < inc.offsets [cur + 1];
+                        k2++)
+                {
+                    const index_t u = g.other (inc.edges [k2], cur);
+                    if (u != prev)
+                    {
+                        nxt = u;
+                        break;
+                    }
+                }
+                prev = cur;
+                cur = nxt;
             }
-            if (d_from > 0.0)
+            if (cur == s)
             {
-                osm_edge_t new_edge = osm_edge_t (two_nbs [1], two_nbs [0],
-                        d_from, wt_from, hw, max_edge_id, replacement_edges);
-                add_to_edge_map (vert2edge_map, two_nbs [0], max_edge_id);
-                add_to_edge_map (vert2edge_map, two_nbs [1], max_edge_id);
-                edge_map.emplace (max_edge_id++, new_edge);
+                // Keep the last vertex as an anchor; its edges to s are then
+                // retained from whichever of the two is their from vertex.
+                cur = chain.back ();
+                chain.pop_back ();
+                intermediate [cur] = 0;
+                visited [cur] = 0;
+                todo.push_back (cur);
             }
-            vert2edge_map.erase (vtx_id);
+            chain.push_back (cur);
+            join_chain (g, inc, intermediate, chain, next_edge_id, chain_edges,
+                    cg);
         }
-        verts.erase (vtx_id);
     }
 
-    for (int e: edges_to_erase)
-        edge_map.erase (e);
+    // Order compact edges, and the map, by compact edge ID
+    const size_t ne = cg.edge_id.size ();
+    std::vector <size_t> order (ne);
+    for (size_t i = 0; i < ne; i++)
+        order [i] = i;
+    std::sort (order.begin (), order.end (), [&cg] (size_t i, size_t j) {
+            return cg.edge_id [i] < cg.edge_id [j]; });
+    compact_graph_t sorted;
+    for (auto i: order)
+        sorted.add_edge (cg.from [i], cg.to [i], cg.highway [i], cg.dist [i],
+                cg.weight [i], cg.edge_id [i]);
+
+    std::vector <size_t> map_order (cg.map_compact.size ());
+    for (size_t i = 0; i < map_order.size (); i++)
+        map_order [i] = i;
+    std::stable_sort (map_order.begin (), map_order.end (),
+            [&cg] (size_t i, size_t j) {
+            return cg.map_compact [i] < cg.map_compact [j]; });
+    for (auto i: map_order)
+    {
+        sorted.map_compact.push_back (cg.map_compact [i]);
+        sorted.map_original.push_back (cg.map_original [i]);
+    }
+    std::swap (cg, sorted);
+}
+
+void graph_from_df (Rcpp::DataFrame gr, osm_graph_t &g)
+{
+    Rcpp::NumericVector from_lon = gr ["from_lon"];
+    Rcpp::NumericVector from_lat = gr ["from_lat"];
+    Rcpp::NumericVector to_lon = gr ["to_lon"];
+    Rcpp::NumericVector to_lat = gr ["to_lat"];
+    Rcpp::NumericVector edge_id = gr ["edge_id"];
+    Rcpp::NumericVector dist = gr ["d"];
+    Rcpp::NumericVector weight = gr ["d_weighted"];
+
+    // IDs may be character or numeric, and highway types character or factor
+    std::vector <vertex_t> from, to;
+    vertex_id_column (gr ["from_id"], from);
+    vertex_id_column (gr ["to_id"], to);
+    highway_column (gr ["highway"], g.highway, g.highways);
+
+    const int ne = to.size ();
+    g.from.resize (ne);
+    g.to.resize (ne);
+    g.dist.assign (dist.begin (), dist.end ());
+    g.weight.assign (weight.begin (), weight.end ());
+    g.edge_id.assign (edge_id.begin (), edge_id.end ());
+    for (int i = 0; i < ne; i ++)
+    {
+        g.from [i] = g.ids.intern (from [i]);
+        if (g.from [i] == g.lon.size ())
+        {
+            g.lon.push_back (from_lon [i]);
+            g.lat.push_back (from_lat [i]);
+        }
+        g.to [i] = g.ids.intern (to [i]);
+        if (g.to [i] == g.lon.size ())
+        {
+            g.lon.push_back (to_lon [i]);
+            g.lat.push_back (to_lat [i]);
+        }
+    }
 }
 
 //' rcpp_make_compact_graph
@@ -321,95 +444,86 @@ void contract_graph (vertex_map_t &vertex_map, edge_map_t &edge_map,
 //' @return \code{Rcpp::List} containing one \code{data.frame} with the compact
 //' graph, one \code{data.frame} with the original graph and one
 //' \code{data.frame} containing information about the relating edge ids of the
-//' original and compact graph.
+//' original and compact graph. Vertex IDs of the compact graph are numeric and
+//' highway types a factor, as for \code{rcpp_lines_as_network}.
 //'
 //' @noRd
 // [[Rcpp::export]]
 Rcpp::List rcpp_make_compact_graph (Rcpp::DataFrame graph, bool quiet)
 {
-    vertex_map_t vertices;
-    edge_map_t edge_map;
-    std::unordered_map <osm_id_t, int> components;
-    int largest_component;
-    vert2edge_map_t vert2edge_map;
+    osm_graph_t g;
+    compact_graph_t cg;
+    Instrument instrument;
+    std::unique_ptr <ScopedTimer> phase;
 
     if (!quiet)
     {
         Rcpp::Rcout << "Constructing graph ... ";
         Rcpp::Rcout.flush ();
     }
-    graph_from_df (graph, vertices, edge_map, vert2edge_map);
+    phase.reset (new ScopedTimer (instrument, "construct"));
+    graph_from_df (graph, g);
+    instrument.count ("vertices", g.nvertices ());
+    instrument.count ("edges", g.from.size ());
+
     if (!quiet)
     {
         Rcpp::Rcout << std::endl << "Determining connected components ... ";
         Rcpp::Rcout.flush ();
     }
-    get_largest_graph_component (vertices, components, largest_component);
+    phase.reset (new ScopedTimer (instrument, "components"));
+    std::vector <index_t> components;
+    index_t largest_component;
+    get_largest_graph_component (g, components, largest_component);
+    filter_graph_component (g, components, largest_component);
+    instrument.count ("component_edges", g.from.size ());
 
     if (!quiet)
     {
         Rcpp::Rcout << std::endl << "Removing intermediate nodes ... ";
         Rcpp::Rcout.flush ();
     }
-    vertex_map_t vertices2 = vertices;
-    edge_map_t edge_map2 = edge_map;
-    contract_graph (vertices2, edge_map2, vert2edge_map);
+    phase.reset (new ScopedTimer (instrument, "contract"));
+    contract_graph (g, cg);
+    instrument.count ("compact_edges", cg.edge_id.size ());
 
     if (!quiet)
     {
         Rcpp::Rcout << std::endl << "Mapping compact to original graph ... ";
         Rcpp::Rcout.flush ();
     }
-    int nedges = edge_map2.size ();
-
-    // These vectors are all for the contracted graph:
-    Rcpp::StringVector from_vec (nedges), to_vec (nedges),
-        highway_vec (nedges);
-    Rcpp::NumericVector from_lat_vec (nedges), from_lon_vec (nedges),
-        to_lat_vec (nedges), to_lon_vec (nedges), dist_vec (nedges),
-        weight_vec (nedges), edgeid_vec (nedges);
-
-    unsigned int map_size = 0; // size of edge map contracted -> original
-    unsigned int en = 0;
-    std::map <int, osm_edge_t> edge_ordered;
-    for (auto e = edge_map2.begin (); e != edge_map2.end (); ++e)
-        edge_ordered.emplace (e->first, e->second);
-
-    for (auto e = edge_ordered.begin (); e != edge_ordered.end (); ++e)
+    phase.reset (new ScopedTimer (instrument, "map"));
+    const size_t nedges = cg.edge_id.size ();
+
+    // These vectors are all for the contracted graph, with vertex IDs and
+    // highway types as for rcpp_lines_as_network:
+    Rcpp::NumericVector from_vec (nedges), to_vec (nedges),
+        from_lat_vec (nedges), from_lon_vec (nedges), to_lat_vec (nedges),
+        to_lon_vec (nedges), dist_vec (nedges), weight_vec (nedges),
+        edgeid_vec (nedges);
+    Rcpp::IntegerVector highway_vec (nedges);
+
+    for (size_t en = 0; en < nedges; en++)
     {
-        osm_id_t from = e->second.get_from_vertex ();
-        osm_id_t to = e->second.get_to_vertex ();
-        osm_vertex_t from_vtx = vertices2.at (from);
-        osm_vertex_t to_vtx = vertices2.at (to);
-
-        from_vec (en) = from;
-        to_vec (en) = to;
-        highway_vec (en) = e->second.highway;
-        dist_vec (en) = e->second.dist;
-        weight_vec (en) = e->second.weight;
-        from_lat_vec (en) = from_vtx.getLat ();
-        from_lon_vec (en) = from_vtx.getLon ();
-        to_lat_vec (en) = to_vtx.getLat ();
-        to_lon_vec (en) = to_vtx.getLon ();
-        edgeid_vec (en) = e->second.getID ();
-
-        map_size += e->second.is_replacement_for ().size ();
-        en++;
+        const index_t from = cg.from [en], to = cg.to [en];
+        from_vec (en) = static_cast <double> (g.ids.ids [from]);
+        to_vec (en) = static_cast <double> (g.ids.ids [to]);
+        highway_vec (en) = static_cast <int> (cg.highway [en]) + 1;
+        dist_vec (en) = cg.dist [en];
+        weight_vec (en) = cg.weight [en];
+        from_lat_vec (en) = g.lat [from];
+        from_lon_vec (en) = g.lon [from];
+        to_lat_vec (en) = g.lat [to];
+        to_lon_vec (en) = g.lon [to];
+        edgeid_vec (en) = cg.edge_id [en];
     }
+    as_factor (highway_vec, g.highways);
+
+    Rcpp::NumericVector edge_id_comp (cg.map_compact.begin (),
+            cg.map_compact.end ());
+    Rcpp::NumericVector edge_id_orig (cg.map_original.begin (),
+            cg.map_original.end ());
 
-    Rcpp::NumericVector edge_id_orig (map_size), edge_id_comp (map_size);
-    int pos = 0;
-    for (auto e = edge_ordered.begin (); e != edge_ordered.end (); ++e)
-    {
-        int eid = e->second.getID ();
-        std::set <int> edges = e->second.is_replacement_for ();
-        for (auto ei: edges)
-        {
-            edge_id_comp (pos) = eid;
-            edge_id_orig (pos++) = ei;
-        }
-    }
-    
     Rcpp::DataFrame compact = Rcpp::DataFrame::create (
             Rcpp::Named ("from_id") = from_vec,
             Rcpp::Named ("to_id") = to_vec,
@@ -426,11 +540,14 @@ Rcpp::List rcpp_make_compact_graph (Rcpp::DataFrame graph, bool quiet)
             Rcpp::Named ("id_compact") = edge_id_comp,
             Rcpp::Named ("id_original") = edge_id_orig);
 
+    phase.reset ();
     if (!quiet)
         Rcpp::Rcout << std::endl;
 
-    return Rcpp::List::create (
+    Rcpp::List res = Rcpp::List::create (
             Rcpp::Named ("compact") = compact,
             Rcpp::Named ("original") = graph,
             Rcpp::Named ("map") = rel);
+    instrument.attach (res);
+    return res;
 }
@@ -0,0 +1,331 @@
+/***************************************************************************
+ *  Project:    osmprob
+ *  File:       haversine.h
+ *  Language:   C++
+ *
+ *  osmprob is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  osmprob is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  osm-router.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Author:     Mark Padgham 
+ *  E-Mail:     mark.padgham@email.com 
+ *
+ *  Description:    Great circle distances, shared between graph construction
+ *                  and distance-based search heuristics, both for single
+ *                  pairs of points and along whole lines of contiguous
+ *                  coordinates.
+ *
+ *  Limitations:    The equirectangular approximation is only accurate for
+ *                  short segments away from the poles.
+ *
+ *  Dependencies:       SSE2 or AVX intrinsics where available
+ *
+ *  Compiler Options:   -std=c++11, -DOSMPROB_SIMD=0 to use only scalar
+ *                      library functions
+ ***************************************************************************/
+
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+#ifndef OSMPROB_SIMD
+#define OSMPROB_SIMD 1
+#endif
+
+#if OSMPROB_SIMD && (defined (__AVX__) || defined (__SSE2__))
+#define OSMPROB_SIMD_LANES 1
+#include <immintrin.h>
+#else
+#define OSMPROB_SIMD_LANES 0
+#endif
+
+const double haversine_radius = 3671.0;
+const double deg_to_rad = M_PI / 180.0;
+
+// Haversine great circle distance between two points
+inline double haversine (double x1, double y1, double x2, double y2)
+{
+    const double sx = std::sin ((x2 - x1) * deg_to_rad / 2.0);
+    const double sy = std::sin ((y2 - y1) * deg_to_rad / 2.0);
+    const double d = sy * sy + std::cos (y1 * deg_to_rad) *
+        std::cos (y2 * deg_to_rad) * sx * sx;
+    return 2.0 * haversine_radius * std::asin (std::sqrt (d));
+}
+
+/************************************************************************
+ ************************************************************************
+ **                                                                    **
+ **                           LINE KERNELS                             **
+ **                                                                    **
+ ************************************************************************
+ ************************************************************************/
+
+/* The line kernels are written once against the following sets of lanes,
+ * which hold either one double, for the tails of lines, or as many as fit in
+ * an SSE2 or AVX register. Library trigonometric functions can not be applied to
+ * registers, so sines, cosines and arcsines are instead evaluated as
+ * polynomials, from arithmetic and square roots only, which every set of
+ * lanes provides. */
+struct scalar_lanes
+{
+    typedef double reg;
+    typedef bool mask;
+    static const size_t width = 1;
+
+    static reg load (const double *p) { return *p; }
+    static void store (double *p, reg x) { *p = x; }
+    static reg set (double x) { return x; }
+    static reg add (reg a, reg b) { return a + b; }
+    static reg sub (reg a, reg b) { return a - b; }
+    static reg mul (reg a, reg b) { return a * b; }
+    static reg div (reg a, reg b) { return a / b; }
+    static reg min (reg a, reg b) { return std::fmin (a, b); }
+    static reg max (reg a, reg b) { return std::fmax (a, b); }
+    static reg sqrt (reg a) { return std::sqrt (a); }
+    static reg abs (reg a) { return std::fabs (a); }
+    // Magnitude of a with the sign of s
+    static reg copysign (reg a, reg s) { return std::copysign (a, s); }
+    static mask gt (reg a, reg b) { return a > b; }
+    static reg select (mask m, reg a, reg b) { return m ? a : b; }
+};
+
+#if OSMPROB_SIMD && defined (__SSE2__)
+struct sse2_lanes
+{
+    typedef __m128d reg;
+    typedef __m128d mask;
+    static const size_t width = 2;
+
+    static reg load (const double *p) { return _mm_loadu_pd (p); }
+    static void store (double *p, reg x) { _mm_storeu_pd (p, x); }
+    static reg set (double x) { return _mm_set1_pd (x); }
+    static reg add (reg a, reg b) { return _mm_add_pd (a, b); }
+    static reg sub (reg a, reg b) { return _mm_sub_pd (a, b); }
+    static reg mul (reg a, reg b) { return _mm_mul_pd (a, b); }
+    static reg div (reg a, reg b) { return _mm_div_pd (a, b); }
+    static reg min (reg a, reg b) { return _mm_min_pd (a, b); }
+    static reg max (reg a, reg b) { return _mm_max_pd (a, b); }
+    static reg sqrt (reg a) { return _mm_sqrt_pd (a); }
+    static reg abs (reg a) { return _mm_andnot_pd (_mm_set1_pd (-0.0), a); }
+    static reg copysign (reg a, reg s)
+    {
+        const reg sign = _mm_set1_pd (-0.0);
+        return _mm_or_pd (_mm_andnot_pd (sign, a), _mm_and_pd (sign, s));
+    }
+    static mask gt (reg a, reg b) { return _mm_cmpgt_pd (a, b); }
+    static reg select (mask m, reg a, reg b)
+    {
+        return _mm_or_pd (_mm_and_pd (m, a), _mm_andnot_pd (m, b));
+    }
+};
+#endif
+
+#if OSMPROB_SIMD && defined (__AVX__)
+struct avx_lanes
+{
+    typedef __m256d reg;
+    typedef __m256d mask;
+    static const size_t width = 4;
+
+    static reg load (const double *p) { return _mm256_loadu_pd (p); }
+    static void store (double *p, reg x) { _mm256_storeu_pd (p, x); }
+    static reg set (double x) { return _mm256_set1_pd (x); }
+    static reg add (reg a, reg b) { return _mm256_add_pd (a, b); }
+    static reg sub (reg a, reg b) { return _mm256_sub_pd (a, b); }
+    static reg mul (reg a, reg b) { return _mm256_mul_pd (a, b); }
+    static reg div (reg a, reg b) { return _mm256_div_pd (a, b); }
+    static reg min (reg a, reg b) { return _mm256_min_pd (a, b); }
+    static reg max (reg a, reg b) { return _mm256_max_pd (a, b); }
+    static reg sqrt (reg a) { return _mm256_sqrt_pd (a); }
+    static reg abs (reg a)
+    {
+        return _mm256_andnot_pd (_mm256_set1_pd (-0.0), a);
+    }
+    static reg copysign (reg a, reg s)
+    {
+        const reg sign = _mm256_set1_pd (-0.0);
+        return _mm256_or_pd (_mm256_andnot_pd (sign, a),
+                _mm256_and_pd (sign, s));
+    }
+    static mask gt (reg a, reg b) { return _mm256_cmp_pd (a, b, _CMP_GT_OQ); }
+    static reg select (mask m, reg a, reg b)
+    {
+        return _mm256_blendv_pd (b, a, m);
+    }
+};
+#endif
+
+// The widest lanes of the target, for all but the tail of each line
+#if OSMPROB_SIMD && defined (__AVX__)
+typedef avx_lanes simd_lanes;
+#elif OSMPROB_SIMD && defined (__SSE2__)
+typedef sse2_lanes simd_lanes;
+#endif
+
+/* sin (x) for |x| <= pi, from its Taylor series on |x| <= pi / 2, on to which
+ * larger |x| are reflected. The truncation error is below 2e-18. */
+template <typename L>
+inline typename L::reg sin_poly (typename L::reg x)
+{
+    typedef typename L::reg reg;
+    const reg ax = L::abs (x);
+    const reg r = L::min (ax, L::sub (L::set (M_PI), ax));
+    const reg r2 = L::mul (r, r);
+    reg p = L::set (1.9572941063391263e-20);
+    p = L::add (L::mul (p, r2), L::set (-8.2206352466243297e-18));
+    p = L::add (L::mul (p, r2), L::set (2.8114572543455206e-15));
+    p = L::add (L::mul (p, r2), L::set (-7.6471637318198164e-13));
+    p = L::add (L::mul (p, r2), L::set (1.6059043836821613e-10));
+    p = L::add (L::mul (p, r2), L::set (-2.5052108385441720e-08));
+    p = L::add (L::mul (p, r2), L::set (2.7557319223985893e-06));
+    p = L::add (L::mul (p, r2), L::set (-1.9841269841269841e-04));
+    p = L::add (L::mul (p, r2), L::set (8.3333333333333333e-03));
+    p = L::add (L::mul (p, r2), L::set (-1.6666666666666666e-01));
+    p = L::add (L::mul (p, r2), L::set (1.0));
+    return L::copysign (L::mul (r, p), x);
+}
+
+/* asin (sqrt (h)) for 0 <= h <= 1, with asin (t) = t + t R (t^2) for
+ * t <= 1/2, where R is the rational approximation of fdlibm's e_asin.c,
+ * accurate to 2^-58, and asin (s) = pi / 2 - 2 asin (sqrt ((1 - s) / 2)) for
+ * larger s = sqrt (h). */
+template <typename L>
+inline typename L::reg asin_sqrt_poly (typename L::reg h)
+{
+    typedef typename L::reg reg;
+    h = L::min (L::max (h, L::set (0.0)), L::set (1.0));
+    const typename L::mask big = L::gt (h, L::set (0.25));
+    const reg t2 = L::select (big, L::mul (L::sub (L::set (1.0),
+                    L::sqrt (h)), L::set (0.5)), h);
+    reg p = L::set (3.47933107596021167570e-05);
+    p = L::add (L::mul (p, t2), L::set (7.91534994289814532176e-04));
+    p = L::add (L::mul (p, t2), L::set (-4.00555345006794114027e-02));
+    p = L::add (L::mul (p, t2), L::set (2.01212532134862925881e-01));
+    p = L::add (L::mul (p, t2), L::set (-3.25565818622400915405e-01));
+    p = L::add (L::mul (p, t2), L::set (1.66666666666666657415e-01));
+    p = L::mul (p, t2);
+    reg q = L::set (7.70381505559019352791e-02);
+    q = L::add (L::mul (q, t2), L::set (-6.88283971605453293030e-01));
+    q = L::add (L::mul (q, t2), L::set (2.02094576023350569471e+00));
+    q = L::add (L::mul (q, t2), L::set (-2.40339491173441421878e+00));
+    q = L::add (L::mul (q, t2), L::set (1.0));
+    const reg t = L::sqrt (t2);
+    const reg a = L::add (t, L::mul (t, L::div (p, q)));
+    return L::select (big, L::sub (L::set (M_PI / 2.0), L::add (a, a)), a);
+}
+
+// cos (lat [j]) for i <= j < n, in steps of the width of L; returns the
+// first j not yet done
+template <typename L>
+inline size_t cos_lat_kernel (const double *lat, double *c, size_t i,
+        size_t n)
+{
+    for (; i + L::width <= n; i += L::width)
+    {
+        const typename L::reg y = L::abs (L::mul (L::load (lat + i),
+                    L::set (deg_to_rad)));
+        L::store (c + i, sin_poly <L> (L::sub (L::set (M_PI / 2.0), y)));
+    }
+    return i;
+}
+
+// Lengths d [j] of segments from point j to j + 1 for i <= j < nseg, as
+// above
+template <typename L>
+inline size_t segment_kernel (const double *lon, const double *lat,
+        const double *c, double *d, size_t i, size_t nseg,
+        bool equirectangular)
+{
+    typedef typename L::reg reg;
+    for (; i + L::width <= nseg; i += L::width)
+    {
+        const reg dx = L::mul (L::sub (L::load (lon + i + 1),
+                    L::load (lon + i)), L::set (deg_to_rad));
+        const reg dy = L::mul (L::sub (L::load (lat + i + 1),
+                    L::load (lat + i)), L::set (deg_to_rad));
+        const reg c0 = L::load (c + i), c1 = L::load (c + i + 1);
+        if (equirectangular)
+        {
+            const reg x = L::mul (L::mul (dx, L::add (c0, c1)), L::set (0.5));
+            L::store (d + i, L::mul (L::set (haversine_radius),
+                        L::sqrt (L::add (L::mul (x, x), L::mul (dy, dy)))));
+        } else
+        {
+            const reg sx = sin_poly <L> (L::mul (dx, L::set (0.5)));
+            const reg sy = sin_poly <L> (L::mul (dy, L::set (0.5)));
+            const reg h = L::add (L::mul (sy, sy),
+                    L::mul (L::mul (L::mul (c0, c1), sx), sx));
+            L::store (d + i, L::mul (L::set (2.0 * haversine_radius),
+                        asin_sqrt_poly <L> (h)));
+        }
+    }
+    return i;
+}
+
+/* Distances between each of the n - 1 pairs of consecutive points of a line,
+ * with longitudes and latitudes in contiguous arrays, as in the columns of sf
+ * LINESTRING matrices. The cosine of each latitude is computed once, in
+ * cos_lat, for both segments which share the point.
+ *
+ * Where SSE2 or AVX are available, the kernels run on the widest lanes for
+ * all but the last few points, which fall back to scalar code. Both evaluate
+ * the same polynomials, so each segment has the same length wherever it
+ * falls, which is within a few units in the last place of that from
+ * haversine (). Elsewhere, the scalar library functions are used, as in
+ * haversine () itself, which are faster than the polynomials on one lane.
+ *
+ * The equirectangular approximation projects each segment on to a plane at
+ * its mean latitude, and needs no further trigonometry. Its relative error is
+ * below 1e-6 for segments of up to 10 km at 60 degrees latitude, and grows
+ * with the square of segment length. */
+inline void line_distances (const double *lon, const double *lat, size_t n,
+        double *d, std::vector <double> &cos_lat, bool equirectangular = false)
+{
+    if (n < 2)
+        return;
+    cos_lat.resize (n);
+    double *c = &cos_lat [0];
+#if OSMPROB_SIMD_LANES
+    size_t i = cos_lat_kernel <simd_lanes> (lat, c, 0, n);
+    cos_lat_kernel <scalar_lanes> (lat, c, i, n);
+
+    i = segment_kernel <simd_lanes> (lon, lat, c, d, 0, n - 1,
+            equirectangular);
+    segment_kernel <scalar_lanes> (lon, lat, c, d, i, n - 1, equirectangular);
+#else
+    for (size_t i = 0; i < n; i++)
+        c [i] = std::cos (lat [i] * deg_to_rad);
+
+    if (equirectangular)
+    {
+        for (size_t i = 0; i < n - 1; i++)
+        {
+            const double x = (lon [i + 1] - lon [i]) * deg_to_rad *
+                (c [i] + c [i + 1]) / 2.0;
+            const double y = (lat [i + 1] - lat [i]) * deg_to_rad;
+            d [i] = haversine_radius * std::sqrt (x * x + y * y);
+        }
+    } else
+    {
+        for (size_t i = 0; i < n - 1; i++)
+        {
+            const double sx = std::sin ((lon [i + 1] - lon [i]) *
+                    deg_to_rad / 2.0);
+            const double sy = std::sin ((lat [i + 1] - lat [i]) *
+                    deg_to_rad / 2.0);
+            const double h = sy * sy + c [i] * c [i + 1] * sx * sx;
+            d [i] = 2.0 * haversine_radius * std::asin (std::sqrt (h));
+        }
+    }
+#endif
+}
@@ -0,0 +1,101 @@
+/***************************************************************************
+ *  Project:    osmprob
+ *  File:       instrument.cpp
+ *  Language:   C++
+ *
+ *  osmprob is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  osmprob is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  osm-router.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Conversion of instrumentation to R attributes
+ *
+ *  Limitations:    See instrument.h
+ *
+ *  Dependencies:       Rcpp
+ *
+ *  Compiler Options:   -std=c++11
+ ***************************************************************************/
+
+#include "instrument.h"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+double peak_rss_bytes ()
+{
+#ifdef _WIN32
+    return 0.0;
+#else
+    struct rusage usage;
+    if (getrusage (RUSAGE_SELF, &usage) != 0)
+        return 0.0;
+#ifdef __APPLE__
+    return static_cast <double> (usage.ru_maxrss);
+#else
+    // kilobytes on Linux and the BSDs
+    return 1024.0 * static_cast <double> (usage.ru_maxrss);
+#endif
+#endif
+}
+
+void Instrument::attach (Rcpp::RObject x)
+{
+    if (!instrumentation_enabled ())
+        return;
+
+    Rcpp::NumericVector timings (_timings.size ()),
+        counters (_counters.size () + 1);
+    Rcpp::CharacterVector tnames (_timings.size ()),
+        cnames (_counters.size () + 1);
+    for (size_t i = 0; i < _timings.size (); i++)
+    {
+        tnames [i] = _timings [i].first;
+        timings [i] = _timings [i].second;
+    }
+    for (size_t i = 0; i < _counters.size (); i++)
+    {
+        cnames [i] = _counters [i].first;
+        counters [i] = _counters [i].second;
+    }
+    // _rss_start is 0 if instrumentation was switched on during the call
+    const double rss = peak_rss_bytes ();
+    cnames [_counters.size ()] = "peak_memory_increase_bytes";
+    counters [_counters.size ()] = _rss_start > 0.0 && rss > _rss_start ?
+        rss - _rss_start : 0.0;
+    timings.attr ("names") = tnames;
+    counters.attr ("names") = cnames;
+
+    x.attr ("instrumentation") = Rcpp::List::create (
+            Rcpp::Named ("timings") = timings,
+            Rcpp::Named ("counters") = counters);
+}
+
+//' rcpp_set_instrumentation
+//'
+//' Switch recording of timings and counters on or off
+//'
+//' @param on Whether to record instrumentation
+//'
+//' @return The previous setting
+//'
+//' @noRd
+// [[Rcpp::export]]
+bool rcpp_set_instrumentation (bool on)
+{
+    const bool prev = instrumentation_flag ();
+    instrumentation_flag () = on;
+    return prev;
+}
@@ -0,0 +1,161 @@
+/***************************************************************************
+ *  Project:    osmprob
+ *  File:       instrument.h
+ *  Language:   C++
+ *
+ *  osmprob is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  osmprob is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  osm-router.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Timings of the phases of a call, and counts of the work
+ *                  done in them, returned to R as the "instrumentation"
+ *                  attribute of its result. Recording is switched on and off
+ *                  at run time with rcpp_set_instrumentation, and costs one
+ *                  test of a flag per phase while off.
+ *
+ *  Limitations:    Memory is measured as the growth of the resident set
+ *                  high-water mark of the whole process from the start of a
+ *                  call, and is 0 whenever a call stays below the peak of
+ *                  an earlier one. It is not available on Windows. Timers
+ *                  and counters are not thread-safe, so each worker of a
+ *                  parallel loop records into its own Instrument, and these
+ *                  are merged afterwards, with timings summed over all
+ *                  workers.
+ *
+ *  Dependencies:       Rcpp
+ *
+ *  Compiler Options:   -std=c++11, -DOSMPROB_INSTRUMENT=0 to compile out all
+ *                      timers
+ ***************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Rcpp.h>
+
+#ifndef OSMPROB_INSTRUMENT
+#define OSMPROB_INSTRUMENT 1
+#endif
+
+inline bool &instrumentation_flag ()
+{
+    static bool on = false;
+    return on;
+}
+
+inline bool instrumentation_enabled ()
+{
+    return OSMPROB_INSTRUMENT && instrumentation_flag ();
+}
+
+// Resident set high-water mark of the process in bytes, or 0 if unknown
+double peak_rss_bytes ();
+
+/* Named timings, in seconds, and counters, each accumulated over all calls of
+ * the same name and held in order of first use. The start of a call is marked
+ * by construction or clear (). */
+class Instrument
+{
+    private:
+        std::vector <std::pair <std::string, double> > _timings, _counters;
+        double _rss_start;
+
+        static void add (std::vector <std::pair <std::string, double> > &v,
+                const char *name, double x)
+        {
+            for (auto &i: v)
+                if (i.first == name)
+                {
+                    i.second += x;
+                    return;
+                }
+            v.push_back (std::make_pair (std::string (name), x));
+        }
+
+    public:
+        Instrument ()
+            : _rss_start (instrumentation_enabled () ? peak_rss_bytes () : 0.0)
+        {}
+
+        void time (const char *name, double seconds)
+        {
+            add (_timings, name, seconds);
+        }
+
+        void count (const char *name, double n)
+        {
+            if (instrumentation_enabled ())
+                add (_counters, name, n);
+        }
+
+        // Add all timings and counters of other to those of this, from the
+        // earlier of their starts
+        void merge (const Instrument &other)
+        {
+            if (other._rss_start < _rss_start)
+                _rss_start = other._rss_start;
+            for (auto &i: other._timings)
+                add (_timings, i.first.c_str (), i.second);
+            for (auto &i: other._counters)
+                add (_counters, i.first.c_str (), i.second);
+        }
+
+        void clear ()
+        {
+            _timings.clear ();
+            _counters.clear ();
+            _rss_start = instrumentation_enabled () ? peak_rss_bytes () : 0.0;
+        }
+
+        /* Set the "instrumentation" attribute of x to a list of named vectors
+         * timings and counters, with the growth of the peak memory of the
+         * process since the start of the call added to counters as
+         * "peak_memory_increase_bytes". Nothing is set while instrumentation
+         * is off. */
+        void attach (Rcpp::RObject x);
+};
+
+// Adds the time from construction to destruction to instrument
+class ScopedTimer
+{
+    private:
+        Instrument &_instrument;
+        const char *_name;
+        bool _on;
+        std::chrono::steady_clock::time_point _start;
+
+    public:
+        ScopedTimer (Instrument &instrument, const char *name)
+            : _instrument (instrument), _name (name),
+            _on (instrumentation_enabled ())
+        {
+            if (_on)
+                _start = std::chrono::steady_clock::now ();
+        }
+
+        ~ScopedTimer ()
+        {
+            if (_on)
+                _instrument.time (_name, std::chrono::duration <double> (
+                            std::chrono::steady_clock::now () - _start).count ());
+        }
+
+        ScopedTimer (const ScopedTimer &) = delete;
+        ScopedTimer &operator= (const ScopedTimer &) = delete;
+};
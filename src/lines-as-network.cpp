@@ -20,7 +20,9 @@
  *  E-Mail:     mark.padgham@email.com 
  *
  *  Description:    Convert sf linestring collection to data.frame of network
- *                  connections
+ *                  connections. Edges are counted in a first pass over all
+ *                  geometries, and then written in parallel directly into
+ *                  typed columns of the data.frame.
  *
  *  Limitations:
  *
@@ -31,19 +33,13 @@
 
 #include <string>
 #include <cmath>
+#include <unordered_map>
 
 #include <Rcpp.h>
 
-// Haversine great circle distance between two points
-float haversine (float x1, float y1, float x2, float y2)
-{
-    float xd = (x2 - x1) * M_PI / 180.0;
-    float yd = (y2 - y1) * M_PI / 180.0;
-    float d = sin (yd / 2.0) * sin (yd / 2.0) + cos (y2 * M_PI / 180.0) *
-        cos (y1 * M_PI / 180.0) * sin (xd / 2.0) * sin (xd / 2.0);
-    d = 2.0 * 3671.0 * asin (sqrt (d));
-    return (d);
-}
+#include "haversine.h"
+#include "network-columns.h"
+#include "parallel.h"
 
 //' rcpp_lines_as_network
 //'
@@ -51,13 +47,16 @@ float haversine (float x1, float y1, float x2, float y2)
 //'
 //' @param sf_lines An sf collection of LINESTRING objects
 //' @param pr Rcpp::DataFrame containing the weighting profile
+//' @param equirectangular If true, segment lengths are calculated with the
+//' equirectangular approximation rather than the haversine formula
 //'
-//' @return Rcpp::List objects of OSM data
+//' @return \code{data.frame} of network edges, with numeric vertex IDs and
+//' highway types as a factor
 //'
 //' @noRd
 // [[Rcpp::export]]
 Rcpp::List rcpp_lines_as_network (const Rcpp::List &sf_lines,
-        Rcpp::DataFrame pr)
+        Rcpp::DataFrame pr, bool equirectangular = false)
 {
     std::map <std::string, float> profile;
     Rcpp::StringVector hw = pr [1];
@@ -103,90 +102,130 @@ Rcpp::List rcpp_lines_as_network (const Rcpp::List &sf_lines,
     }
 
     Rcpp::List geoms = sf_lines [nms.size () - 1];
-    std::vector<bool> isOneWay (geoms.length ());
-    std::fill (isOneWay.begin (), isOneWay.end (), false);
-    // Get dimension of matrix
-    size_t nrows = 0;
-    int ngeoms = 0;
-    for (auto g = geoms.begin (); g != geoms.end (); ++g)
+    const size_t ngeoms = geoms.size ();
+
+    /* The first pass counts the edges of each geometry, and gathers pointers
+     * to everything needed to fill them, so that the second pass, over
+     * geometries in parallel, need not touch any R objects other than the
+     * pre-allocated columns. */
+    std::vector <size_t> edge_offset (ngeoms + 1, 0), node_offset (ngeoms + 1, 0);
+    std::vector <const double *> coords (ngeoms);
+    std::vector <bool> isOneWay (ngeoms, false);
+    std::vector <int> hw_code (ngeoms);
+    std::vector <double> hw_factor (ngeoms);
+    /* Node IDs are parsed from rownames here, so that invalid IDs are reported
+     * before, rather than thrown from within, the parallel pass. Geometries
+     * without rownames are given consecutive IDs from 0. */
+    std::vector <vertex_t> node_ids;
+    std::vector <std::string> levels;
+    std::unordered_map <SEXP, int> level_index;
+    vertex_t fake_id = 0;
+    for (size_t g = 0; g < ngeoms; g++)
     {
         // Rcpp uses an internal proxy iterator here, NOT a direct copy
-        Rcpp::NumericMatrix gi = (*g);
-        int rows = gi.nrow () - 1;
-        nrows += rows;
-        if (ngeoms < ow.size ())
+        Rcpp::NumericMatrix gi = geoms [g];
+        const size_t n = static_cast <size_t> (gi.nrow ());
+        coords [g] = gi.begin ();
+        node_offset [g + 1] = node_offset [g] + n;
+        size_t nedges = n > 0 ? n - 1 : 0;
+        if (g < static_cast <size_t> (ow.size ()))
+        {
+            if (!(ow [g] == "yes" || ow [g] == "-1"))
+                isOneWay [g] = true;
+        }
+        if (isOneWay [g])
+            nedges *= 2;
+        edge_offset [g + 1] = edge_offset [g] + nedges;
+
+        // Highway types are interned by their CHARSXP, shared by R between
+        // all equal strings
+        SEXP hway = g < static_cast <size_t> (highway.size ()) ?
+            STRING_ELT (highway, g) : NA_STRING;
+        auto h = level_index.find (hway);
+        if (h == level_index.end ())
+        {
+            h = level_index.emplace (hway, levels.size () + 1).first;
+            levels.push_back (std::string (CHAR (hway)));
+        }
+        hw_code [g] = h->second;
+        float f = profile [levels [h->second - 1]];
+        if (f == 0.0) f = 1e-5;
+        hw_factor [g] = 1.0 / f;
+
+        SEXP ginames = Rf_getAttrib (gi, R_DimNamesSymbol);
+        SEXP rnms = Rf_isNull (ginames) ? R_NilValue : VECTOR_ELT (ginames, 0);
+        if (Rf_isNull (rnms))
+        {
+            for (size_t i = 0; i < n; i++)
+                node_ids.push_back (fake_id++);
+        } else
         {
-            if (!(ow [ngeoms] == "yes" || ow [ngeoms] == "-1"))
+            if (static_cast <size_t> (Rf_xlength (rnms)) != n)
+                throw std::runtime_error ("geom size differs from rownames");
+            for (size_t i = 0; i < n; i++)
             {
-                nrows += rows;
-                isOneWay [ngeoms] = true;
+                const char *name = CHAR (STRING_ELT (rnms, i));
+                vertex_t id;
+                if (!parse_vertex_id (name, id))
+                    throw std::runtime_error ("geometry " +
+                            std::to_string (g + 1) + " has node ID '" + name +
+                            "', but rownames must be integer OSM node IDs");
+                node_ids.push_back (id);
             }
         }
-        ngeoms ++;
     }
 
-    Rcpp::NumericMatrix nmat = Rcpp::NumericMatrix (Rcpp::Dimension (nrows, 6));
-    Rcpp::CharacterMatrix idmat = Rcpp::CharacterMatrix (Rcpp::Dimension (nrows,
-                3));
+    network_columns_t net (edge_offset [ngeoms]);
+    double *from_id = net.from_id.begin (), *to_id = net.to_id.begin (),
+           *from_lon = net.from_lon.begin (), *from_lat = net.from_lat.begin (),
+           *to_lon = net.to_lon.begin (), *to_lat = net.to_lat.begin (),
+           *dist = net.d.begin (), *dist_wt = net.d_weighted.begin ();
+    int *hw_col = net.highway.begin ();
 
-    nrows = 0;
-    ngeoms = 0;
-    int fake_id = 0;
-    for (auto g = geoms.begin (); g != geoms.end (); ++ g)
-    {
-        Rcpp::NumericMatrix gi = (*g);
-        std::string hway = std::string (highway [ngeoms]);
-        float hw_factor = profile [hway];
-        if (hw_factor == 0.0) hw_factor = 1e-5;
-        hw_factor = 1.0 / hw_factor;
+    // Scratch space of each worker: segment lengths and cosines
+    const int nthreads = get_num_threads ();
+    std::vector <std::vector <double> > d_w (nthreads), cos_w (nthreads);
 
-        Rcpp::List ginames = gi.attr ("dimnames");
-        Rcpp::CharacterVector rnms;
-        if (ginames.length () > 0)
-            rnms = ginames [0];
-        else
-        {
-            rnms = Rcpp::CharacterVector (gi.nrow ());
-            for (int i = 0; i < gi.nrow (); i ++)
-                rnms [i] = fake_id ++;
-        }
-        if (rnms.size () != gi.nrow ())
-            throw std::runtime_error ("geom size differs from rownames");
+    parallel_for (ngeoms, [&] (size_t g, int worker)
+    {
+        const size_t n = node_offset [g + 1] - node_offset [g];
+        if (n < 2)
+            return;
+        const double *x = coords [g], *y = x + n;
+        std::vector <double> &d = d_w [worker];
+        d.resize (n - 1);
+        line_distances (x, y, n, &d [0], cos_w [worker], equirectangular);
+        const vertex_t *ids = &node_ids [node_offset [g]];
 
-        for (int i = 1; i < gi.nrow (); i ++)
+        const bool both_ways = isOneWay [g];
+        size_t e = edge_offset [g];
+        for (size_t i = 1; i < n; i ++)
         {
-            float d = haversine (gi (i-1, 0), gi (i-1, 1), gi (i, 0),
-                    gi (i, 1));
-            nmat (nrows, 0) = gi (i-1, 0);
-            nmat (nrows, 1) = gi (i-1, 1);
-            nmat (nrows, 2) = gi (i, 0);
-            nmat (nrows, 3) = gi (i, 1);
-            nmat (nrows, 4) = d;
-            nmat (nrows, 5) = d * hw_factor;
-            idmat (nrows, 0) = rnms (i-1);
-            idmat (nrows, 1) = rnms (i);
-            idmat (nrows, 2) = hway;
-            nrows ++;
-            if (isOneWay [ngeoms])
+            from_id [e] = static_cast <double> (ids [i - 1]);
+            to_id [e] = static_cast <double> (ids [i]);
+            from_lon [e] = x [i - 1];
+            from_lat [e] = y [i - 1];
+            to_lon [e] = x [i];
+            to_lat [e] = y [i];
+            dist [e] = d [i - 1];
+            dist_wt [e] = d [i - 1] * hw_factor [g];
+            hw_col [e] = hw_code [g];
+            e++;
+            if (both_ways)
             {
-                nmat (nrows, 0) = gi (i, 0);
-                nmat (nrows, 1) = gi (i, 1);
-                nmat (nrows, 2) = gi (i-1, 0);
-                nmat (nrows, 3) = gi (i-1, 1);
-                nmat (nrows, 4) = d;
-                nmat (nrows, 5) = d * hw_factor;
-                idmat (nrows, 0) = rnms (i);
-                idmat (nrows, 1) = rnms (i-1);
-                idmat (nrows, 2) = hway;
-                nrows ++;
+                from_id [e] = static_cast <double> (ids [i]);
+                to_id [e] = static_cast <double> (ids [i - 1]);
+                from_lon [e] = x [i];
+                from_lat [e] = y [i];
+                to_lon [e] = x [i - 1];
+                to_lat [e] = y [i - 1];
+                dist [e] = d [i - 1];
+                dist_wt [e] = d [i - 1] * hw_factor [g];
+                hw_col [e] = hw_code [g];
+                e++;
             }
         }
-        ngeoms ++;
-    }
-
-    Rcpp::List res (2);
-    res [0] = nmat;
-    res [1] = idmat;
+    });
 
-    return res;
+    return net.data_frame (levels);
 }
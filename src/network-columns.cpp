@@ -0,0 +1,163 @@
+/***************************************************************************
+ *  Project:    osmprob
+ *  File:       network-columns.cpp
+ *  Language:   C++
+ *
+ *  osmprob is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  osmprob is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  osm-router.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Typed columns of network data.frames
+ *
+ *  Limitations:    See network-columns.h
+ *
+ *  Dependencies:       Rcpp
+ *
+ *  Compiler Options:   -std=c++11
+ ***************************************************************************/
+
+#include <cmath>
+#include <numeric>
+#include <unordered_map>
+
+#include "network-columns.h"
+
+network_columns_t::network_columns_t (size_t n) :
+    edge_id (Rcpp::no_init (n)), highway (Rcpp::no_init (n)),
+    from_id (Rcpp::no_init (n)), from_lon (Rcpp::no_init (n)),
+    from_lat (Rcpp::no_init (n)), to_id (Rcpp::no_init (n)),
+    to_lon (Rcpp::no_init (n)), to_lat (Rcpp::no_init (n)),
+    d (Rcpp::no_init (n)), d_weighted (Rcpp::no_init (n))
+{
+    std::iota (edge_id.begin (), edge_id.end (), 1);
+}
+
+void as_factor (Rcpp::IntegerVector codes,
+        const std::vector <std::string> &levels)
+{
+    codes.attr ("levels") = Rcpp::CharacterVector (levels.begin (),
+            levels.end ());
+    codes.attr ("class") = "factor";
+}
+
+Rcpp::List network_columns_t::data_frame (
+        const std::vector <std::string> &levels)
+{
+    as_factor (highway, levels);
+
+    Rcpp::List df = Rcpp::List::create (
+            Rcpp::Named ("edge_id") = edge_id,
+            Rcpp::Named ("from_id") = from_id,
+            Rcpp::Named ("from_lon") = from_lon,
+            Rcpp::Named ("from_lat") = from_lat,
+            Rcpp::Named ("to_id") = to_id,
+            Rcpp::Named ("to_lon") = to_lon,
+            Rcpp::Named ("to_lat") = to_lat,
+            Rcpp::Named ("d") = d,
+            Rcpp::Named ("d_weighted") = d_weighted,
+            Rcpp::Named ("highway") = highway);
+    // Compact row names, as used by R for 1:n
+    df.attr ("row.names") = Rcpp::IntegerVector::create (NA_INTEGER,
+            -static_cast <int> (edge_id.size ()));
+    df.attr ("class") = "data.frame";
+    return df;
+}
+
+void vertex_id_column (SEXP col, std::vector <vertex_t> &ids)
+{
+    const R_xlen_t n = Rf_xlength (col);
+    ids.resize (n);
+    if (Rf_isFactor (col))
+    {
+        std::vector <vertex_t> levels;
+        vertex_id_column (Rf_getAttrib (col, R_LevelsSymbol), levels);
+        const int *x = INTEGER (col);
+        for (R_xlen_t i = 0; i < n; i++)
+        {
+            if (x [i] == NA_INTEGER)
+                throw std::runtime_error ("vertex IDs must not be NA");
+            ids [i] = levels [x [i] - 1];
+        }
+    } else if (TYPEOF (col) == STRSXP)
+    {
+        for (R_xlen_t i = 0; i < n; i++)
+            ids [i] = parse_vertex_id (CHAR (STRING_ELT (col, i)));
+    } else if (TYPEOF (col) == INTSXP)
+    {
+        const int *x = INTEGER (col);
+        for (R_xlen_t i = 0; i < n; i++)
+        {
+            if (x [i] == NA_INTEGER)
+                throw std::runtime_error ("vertex IDs must not be NA");
+            ids [i] = x [i];
+        }
+    } else if (TYPEOF (col) == REALSXP)
+    {
+        // Beyond 2^53, doubles no longer hold every integer
+        const double max_id = 9007199254740992.0;
+        const double *x = REAL (col);
+        for (R_xlen_t i = 0; i < n; i++)
+        {
+            if (x [i] != std::floor (x [i]) || std::fabs (x [i]) > max_id)
+                throw std::runtime_error ("vertex ID " +
+                        std::to_string (x [i]) + " is not an integer");
+            ids [i] = static_cast <vertex_t> (x [i]);
+        }
+    } else
+        throw std::runtime_error ("vertex IDs must be character or numeric");
+}
+
+void highway_column (SEXP col, std::vector <index_t> &highway,
+        std::vector <std::string> &types)
+{
+    std::unordered_map <std::string, index_t> index;
+    for (index_t i = 0; i < types.size (); i++)
+        index.emplace (types [i], i);
+    // NA types become "NA", as for any other character value
+    auto intern = [&] (SEXP s) {
+        auto it = index.emplace (std::string (CHAR (s)), types.size ());
+        if (it.second)
+            types.push_back (it.first->first);
+        return it.first->second;
+    };
+
+    const R_xlen_t n = Rf_xlength (col);
+    highway.resize (n);
+    if (Rf_isFactor (col))
+    {
+        SEXP levels = Rf_getAttrib (col, R_LevelsSymbol);
+        std::vector <index_t> codes (Rf_xlength (levels));
+        for (size_t i = 0; i < codes.size (); i++)
+            codes [i] = intern (STRING_ELT (levels, i));
+        const int *x = INTEGER (col);
+        for (R_xlen_t i = 0; i < n; i++)
+            highway [i] = x [i] == NA_INTEGER ? intern (NA_STRING) :
+                codes [x [i] - 1];
+    } else if (TYPEOF (col) == STRSXP)
+    {
+        /* R shares one CHARSXP between all equal strings, so that each type
+         * is only converted to std::string once. */
+        std::unordered_map <SEXP, index_t> hw_index;
+        for (R_xlen_t i = 0; i < n; i++)
+        {
+            SEXP s = STRING_ELT (col, i);
+            auto h = hw_index.find (s);
+            if (h == hw_index.end ())
+                h = hw_index.emplace (s, intern (s)).first;
+            highway [i] = h->second;
+        }
+    } else
+        throw std::runtime_error ("highway types must be character or factor");
+}
@@ -0,0 +1,70 @@
+/***************************************************************************
+ *  Project:    osmprob
+ *  File:       network-columns.h
+ *  Language:   C++
+ *
+ *  osmprob is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  osmprob is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  osm-router.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Typed columns of network data.frames, as returned by
+ *                  rcpp_lines_as_network, rcpp_read_osm and
+ *                  rcpp_make_compact_graph, and readers of vertex ID and
+ *                  highway columns which accept both these and the character
+ *                  columns of user-supplied data.frames.
+ *
+ *  Limitations:    Numeric vertex IDs are doubles, and so only exact up to
+ *                  2^53, which is well above all OSM IDs.
+ *
+ *  Dependencies:       Rcpp
+ *
+ *  Compiler Options:   -std=c++11
+ ***************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <Rcpp.h>
+
+#include "graph-csr.h"
+
+/* Columns of a network data.frame of n edges, allocated without
+ * initialisation so that they can be filled directly, in parallel, through
+ * their data pointers. highway holds R factor codes, starting from 1. */
+struct network_columns_t
+{
+    Rcpp::IntegerVector edge_id, highway;
+    Rcpp::NumericVector from_id, from_lon, from_lat, to_id, to_lon, to_lat,
+        d, d_weighted;
+
+    network_columns_t (size_t n);
+
+    // The data.frame of all columns, with highway a factor of levels
+    Rcpp::List data_frame (const std::vector <std::string> &levels);
+};
+
+// Sets codes, starting from 1, to be a factor of levels
+void as_factor (Rcpp::IntegerVector codes,
+        const std::vector <std::string> &levels);
+
+// Vertex IDs of a character, factor or numeric column
+void vertex_id_column (SEXP col, std::vector <vertex_t> &ids);
+
+/* Highway types of a character or factor column, as indices into types. Types
+ * are only appended, so that types may be shared between several columns. */
+void highway_column (SEXP col, std::vector <index_t> &highway,
+        std::vector <std::string> &types);
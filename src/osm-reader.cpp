@@ -0,0 +1,427 @@
+/***************************************************************************
+ *  Project:    osmprob
+ *  File:       osm-reader.cpp
+ *  Language:   C++
+ *
+ *  osmprob is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  osmprob is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  osm-router.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Convert OSM XML files to data.frames of network
+ *                  connections, without the intermediate sf objects of
+ *                  rcpp_lines_as_network.
+ *
+ *  Limitations:    See osm-reader.h
+ *
+ *  Dependencies:       none
+ *
+ *  Compiler Options:   -std=c++11
+ ***************************************************************************/
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include <Rcpp.h>
+
+#include "osm-reader.h"
+#include "haversine.h"
+#include "network-columns.h"
+
+const size_t xml_block_size = 1 << 16;
+
+inline bool is_space (int c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+const std::string *xml_tag_t::attr (const char *key) const
+{
+    for (size_t i = 0; i < nattrs; i++)
+        if (attrs [i].first == key)
+            return &attrs [i].second;
+    return nullptr;
+}
+
+XmlTagStream::XmlTagStream (const std::string &filename)
+    : _buf (xml_block_size), _pos (0), _len (0)
+{
+    _file = std::fopen (filename.c_str (), "rb");
+    if (!_file)
+        throw std::runtime_error ("unable to open file " + filename);
+}
+
+XmlTagStream::~XmlTagStream ()
+{
+    std::fclose (_file);
+}
+
+bool XmlTagStream::fill ()
+{
+    _len = std::fread (&_buf [0], 1, _buf.size (), _file);
+    _pos = 0;
+    return _len > 0;
+}
+
+bool XmlTagStream::skip_past (const char *s)
+{
+    const size_t n = std::strlen (s);
+    std::string tail;
+    int c;
+    while ((c = get ()) != EOF)
+    {
+        tail.push_back (static_cast <char> (c));
+        if (tail.size () > n)
+            tail.erase (0, 1);
+        if (tail == s)
+            return true;
+    }
+    return false;
+}
+
+// Attribute value up to the closing quote, with entities decoded
+void XmlTagStream::read_value (int quote, std::string &value)
+{
+    value.clear ();
+    int c;
+    while ((c = get ()) != quote)
+    {
+        if (c == EOF)
+            throw std::runtime_error ("unterminated attribute value in XML");
+        if (c != '&')
+        {
+            value.push_back (static_cast <char> (c));
+            continue;
+        }
+
+        std::string entity;
+        while ((c = get ()) != ';')
+        {
+            if (c == EOF || c == quote || entity.size () > 8)
+                throw std::runtime_error ("malformed entity in XML");
+            entity.push_back (static_cast <char> (c));
+        }
+        if (entity == "amp")
+            value.push_back ('&');
+        else if (entity == "lt")
+            value.push_back ('<');
+        else if (entity == "gt")
+            value.push_back ('>');
+        else if (entity == "quot")
+            value.push_back ('"');
+        else if (entity == "apos")
+            value.push_back ('\'');
+        else if (entity.size () > 1 && entity [0] == '#')
+        {
+            // Character reference, encoded as UTF-8
+            unsigned long cp = entity [1] == 'x' ?
+                std::strtoul (entity.c_str () + 2, nullptr, 16) :
+                std::strtoul (entity.c_str () + 1, nullptr, 10);
+            if (cp < 0x80)
+                value.push_back (static_cast <char> (cp));
+            else if (cp < 0x800)
+            {
+                value.push_back (static_cast <char> (0xC0 | (cp >> 6)));
+                value.push_back (static_cast <char> (0x80 | (cp & 0x3F)));
+            } else if (cp < 0x10000)
+            {
+                value.push_back (static_cast <char> (0xE0 | (cp >> 12)));
+                value.push_back (static_cast <char> (0x80 | ((cp >> 6) & 0x3F)));
+                value.push_back (static_cast <char> (0x80 | (cp & 0x3F)));
+            } else
+            {
+                value.push_back (static_cast <char> (0xF0 | (cp >> 18)));
+                value.push_back (static_cast <char> (0x80 | ((cp >> 12) & 0x3F)));
+                value.push_back (static_cast <char> (0x80 | ((cp >> 6) & 0x3F)));
+                value.push_back (static_cast <char> (0x80 | (cp & 0x3F)));
+            }
+        } else
+            throw std::runtime_error ("unknown entity &" + entity + "; in XML");
+    }
+}
+
+bool XmlTagStream::next (xml_tag_t &tag)
+{
+    int c;
+    while (true)
+    {
+        do
+            c = get ();
+        while (c != EOF && c != '<');
+        if (c == EOF)
+            return false;
+
+        c = get ();
+        if (c == '?')
+        {
+            if (!skip_past ("?>"))
+                throw std::runtime_error ("unterminated declaration in XML");
+        } else if (c == '!')
+        {
+            c = get ();
+            bool ok;
+            if (c == '-' && get () == '-')
+                ok = skip_past ("-->");
+            else if (c == '[')
+                ok = skip_past ("]]>");
+            else
+                ok = skip_past (">");
+            if (!ok)
+                throw std::runtime_error ("unterminated comment in XML");
+        } else
+            break;
+    }
+
+    tag.closing = c == '/';
+    if (tag.closing)
+        c = get ();
+    tag.self_closing = false;
+    tag.nattrs = 0;
+    tag.name.clear ();
+    while (c != EOF && !is_space (c) && c != '>' && c != '/')
+    {
+        tag.name.push_back (static_cast <char> (c));
+        c = get ();
+    }
+
+    while (true)
+    {
+        while (is_space (c))
+            c = get ();
+        if (c == EOF)
+            throw std::runtime_error ("unterminated tag <" + tag.name +
+                    "> in XML");
+        if (c == '>')
+            break;
+        if (c == '/')
+        {
+            tag.self_closing = true;
+            c = get ();
+            continue;
+        }
+
+        if (tag.nattrs == tag.attrs.size ())
+            tag.attrs.emplace_back ();
+        std::pair <std::string, std::string> &a = tag.attrs [tag.nattrs++];
+        a.first.clear ();
+        while (c != EOF && c != '=' && !is_space (c) && c != '>' && c != '/')
+        {
+            a.first.push_back (static_cast <char> (c));
+            c = get ();
+        }
+        while (is_space (c))
+            c = get ();
+        if (c != '=')
+            throw std::runtime_error ("attribute " + a.first + " of <" +
+                    tag.name + "> has no value");
+        do
+            c = get ();
+        while (is_space (c));
+        if (c != '"' && c != '\'')
+            throw std::runtime_error ("attribute " + a.first + " of <" +
+                    tag.name + "> is not quoted");
+        read_value (c, a.second);
+        c = get ();
+    }
+
+    return true;
+}
+
+/* Nodes are held in a vector sorted by ID, which takes a third of the memory
+ * of a hash table. Files are generally sorted already, so sorting is only
+ * needed where they are not. */
+class OsmNodeTable
+{
+    private:
+        std::vector <osm_node_t> _nodes;
+        bool _sorted;
+
+    public:
+        OsmNodeTable () : _sorted (true) {}
+
+        void add (const osm_node_t &n)
+        {
+            if (!_nodes.empty () && n.id < _nodes.back ().id)
+                _sorted = false;
+            _nodes.push_back (n);
+        }
+
+        const osm_node_t *find (vertex_t id)
+        {
+            if (!_sorted)
+            {
+                std::stable_sort (_nodes.begin (), _nodes.end ());
+                _sorted = true;
+            }
+            osm_node_t key;
+            key.id = id;
+            auto it = std::lower_bound (_nodes.begin (), _nodes.end (), key);
+            return it == _nodes.end () || it->id != id ? nullptr : &(*it);
+        }
+};
+
+inline void add_edge (const osm_node_t *a, const osm_node_t *b, double d,
+        double hw_factor, index_t hw, osm_edges_t &edges)
+{
+    edges.from.push_back (a->id);
+    edges.to.push_back (b->id);
+    edges.from_lon.push_back (a->lon);
+    edges.from_lat.push_back (a->lat);
+    edges.to_lon.push_back (b->lon);
+    edges.to_lat.push_back (b->lat);
+    edges.d.push_back (d);
+    edges.d_weighted.push_back (d * hw_factor);
+    edges.highway.push_back (hw);
+}
+
+void read_osm_edges (const std::string &filename,
+        const std::map <std::string, float> &profile, osm_edges_t &edges)
+{
+    XmlTagStream xml (filename);
+    xml_tag_t tag;
+    OsmNodeTable nodes;
+    std::map <std::string, index_t> highway_index;
+
+    // The way currently being read
+    bool in_way = false, has_oneway = false;
+    std::vector <vertex_t> way_nodes;
+    std::string highway, oneway, oneway_bicycle;
+
+    while (xml.next (tag))
+    {
+        if (tag.name == "node" && !tag.closing)
+        {
+            const std::string *id = tag.attr ("id"),
+                  *lon = tag.attr ("lon"), *lat = tag.attr ("lat");
+            if (id && lon && lat)
+            {
+                osm_node_t n;
+                n.id = std::strtoll (id->c_str (), nullptr, 10);
+                n.lon = std::strtod (lon->c_str (), nullptr);
+                n.lat = std::strtod (lat->c_str (), nullptr);
+                nodes.add (n);
+            }
+        } else if (tag.name == "way" && !tag.closing)
+        {
+            in_way = !tag.self_closing;
+            way_nodes.clear ();
+            highway.clear ();
+            oneway.clear ();
+            oneway_bicycle.clear ();
+            has_oneway = false;
+        } else if (in_way && tag.name == "nd")
+        {
+            const std::string *ref = tag.attr ("ref");
+            if (ref)
+                way_nodes.push_back (std::strtoll (ref->c_str (), nullptr, 10));
+        } else if (in_way && tag.name == "tag")
+        {
+            const std::string *k = tag.attr ("k"), *v = tag.attr ("v");
+            if (!k || !v)
+                continue;
+            if (*k == "highway")
+                highway = *v;
+            else if (*k == "oneway")
+            {
+                oneway = *v;
+                has_oneway = true;
+            } else if (*k == "oneway:bicycle")
+                oneway_bicycle = *v;
+        } else if (tag.name == "way" && tag.closing && in_way)
+        {
+            in_way = false;
+            if (highway.empty ())
+                continue;
+
+            // oneway:bicycle only applies where oneway is absent, as for
+            // rcpp_lines_as_network
+            const std::string &ow = has_oneway ? oneway : oneway_bicycle;
+            const bool backward_only = ow == "-1";
+            const bool forward_only = ow == "yes" || ow == "true" ||
+                ow == "1";
+
+            auto p = profile.find (highway);
+            double hw_factor = p == profile.end () ? 0.0 : p->second;
+            if (hw_factor == 0.0) hw_factor = 1e-5;
+            hw_factor = 1.0 / hw_factor;
+
+            auto h = highway_index.find (highway);
+            if (h == highway_index.end ())
+            {
+                h = highway_index.insert (std::make_pair (highway,
+                            static_cast <index_t> (
+                                edges.highway_types.size ()))).first;
+                edges.highway_types.push_back (highway);
+            }
+
+            for (size_t i = 1; i < way_nodes.size (); i++)
+            {
+                const osm_node_t *a = nodes.find (way_nodes [i - 1]);
+                const osm_node_t *b = nodes.find (way_nodes [i]);
+                if (!a || !b)
+                    continue;
+                const double d = haversine (a->lon, a->lat, b->lon, b->lat);
+                if (!backward_only)
+                    add_edge (a, b, d, hw_factor, h->second, edges);
+                if (!forward_only)
+                    add_edge (b, a, d, hw_factor, h->second, edges);
+            }
+        }
+    }
+}
+
+//' rcpp_read_osm
+//'
+//' Read the highway ways of an OSM XML file as network connections
+//'
+//' @param filename Name of a \code{.osm} file
+//' @param pr Rcpp::DataFrame containing the weighting profile
+//'
+//' @return The network \code{data.frame}, as for \code{osmlines_as_network}
+//'
+//' @noRd
+// [[Rcpp::export]]
+Rcpp::List rcpp_read_osm (std::string filename, Rcpp::DataFrame pr)
+{
+    std::map <std::string, float> profile;
+    Rcpp::StringVector hw = pr [1];
+    Rcpp::NumericVector val = pr [2];
+    for (int i = 0; i != hw.size (); i ++)
+        profile.insert (std::make_pair (std::string (hw [i]), val [i]));
+
+    osm_edges_t edges;
+    read_osm_edges (filename, profile, edges);
+
+    const size_t n = edges.from.size ();
+    network_columns_t net (n);
+    for (size_t i = 0; i < n; i++)
+    {
+        net.from_id [i] = static_cast <double> (edges.from [i]);
+        net.to_id [i] = static_cast <double> (edges.to [i]);
+        net.highway [i] = static_cast <int> (edges.highway [i]) + 1;
+    }
+    std::copy (edges.from_lon.begin (), edges.from_lon.end (),
+            net.from_lon.begin ());
+    std::copy (edges.from_lat.begin (), edges.from_lat.end (),
+            net.from_lat.begin ());
+    std::copy (edges.to_lon.begin (), edges.to_lon.end (), net.to_lon.begin ());
+    std::copy (edges.to_lat.begin (), edges.to_lat.end (), net.to_lat.begin ());
+    std::copy (edges.d.begin (), edges.d.end (), net.d.begin ());
+    std::copy (edges.d_weighted.begin (), edges.d_weighted.end (),
+            net.d_weighted.begin ());
+
+    return net.data_frame (edges.highway_types);
+}
@@ -0,0 +1,112 @@
+/***************************************************************************
+ *  Project:    osmprob
+ *  File:       osm-reader.h
+ *  Language:   C++
+ *
+ *  osmprob is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  osmprob is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  osm-router.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Streaming reader for OSM XML (.osm) files, which converts
+ *                  highway ways directly to network edges. The file is read
+ *                  in fixed-size blocks, one tag at a time, so memory is
+ *                  constant apart from the table of node coordinates and the
+ *                  resultant edges.
+ *
+ *  Limitations:    Nodes must precede the ways which refer to them, as in all
+ *                  OSM API, Overpass and osmium output. Way segments with
+ *                  nodes not in the file are skipped. Text content, CDATA and
+ *                  DOCTYPE internal subsets are not parsed.
+ *
+ *  Dependencies:       none (no Rcpp)
+ *
+ *  Compiler Options:   -std=c++11
+ ***************************************************************************/
+
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "graph-csr.h"
+
+/* One start or end tag. Attribute strings are reused from one tag to the
+ * next, so only the first nattrs entries of attrs are current. */
+struct xml_tag_t
+{
+    std::string name;
+    bool closing, self_closing;
+    std::vector <std::pair <std::string, std::string> > attrs;
+    size_t nattrs;
+
+    // Value of attribute key, or nullptr if absent
+    const std::string *attr (const char *key) const;
+};
+
+class XmlTagStream
+{
+    private:
+        std::FILE *_file;
+        std::vector <char> _buf;
+        size_t _pos, _len;
+
+        bool fill ();
+        // Next character, or EOF
+        inline int get ()
+        {
+            if (_pos == _len && !fill ())
+                return EOF;
+            return static_cast <unsigned char> (_buf [_pos++]);
+        }
+        // Skip past the next occurrence of s; false if not found
+        bool skip_past (const char *s);
+        void read_value (int quote, std::string &value);
+
+    public:
+        XmlTagStream (const std::string &filename);
+        ~XmlTagStream ();
+        XmlTagStream (const XmlTagStream &) = delete;
+        XmlTagStream &operator= (const XmlTagStream &) = delete;
+
+        // Read the next tag, skipping text, comments and declarations; false
+        // at the end of the file.
+        bool next (xml_tag_t &tag);
+};
+
+struct osm_node_t
+{
+    vertex_t id;
+    double lon, lat;
+
+    bool operator< (const osm_node_t &n) const { return id < n.id; }
+};
+
+/* Edges between consecutive nodes of highway ways, in both directions unless
+ * the way is one-way. highway holds indices into highway_types. */
+struct osm_edges_t
+{
+    std::vector <vertex_t> from, to;
+    std::vector <double> from_lon, from_lat, to_lon, to_lat, d, d_weighted;
+    std::vector <index_t> highway;
+    std::vector <std::string> highway_types;
+};
+
+/* Read all highway ways of filename into edges. profile maps highway types to
+ * their relative preference in (0, 1], with d_weighted = d / preference; types
+ * not in the profile are effectively excluded by a preference of 1e-5. */
+void read_osm_edges (const std::string &filename,
+        const std::map <std::string, float> &profile, osm_edges_t &edges);
@@ -4,19 +4,65 @@
 #include <R_ext/Rdynload.h>
 
 /* .Call calls */
-extern SEXP _osmprob_rcpp_lines_as_network(SEXP, SEXP);
+extern SEXP _osmprob_rcpp_ch_build(SEXP, SEXP, SEXP, SEXP);
+extern SEXP _osmprob_rcpp_ch_query(SEXP, SEXP, SEXP);
+extern SEXP _osmprob_rcpp_distance_matrix(SEXP, SEXP, SEXP);
+extern SEXP _osmprob_rcpp_expand_path(SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP _osmprob_rcpp_graph_nearest(SEXP, SEXP, SEXP, SEXP);
+extern SEXP _osmprob_rcpp_index_nearest(SEXP, SEXP, SEXP, SEXP);
+extern SEXP _osmprob_rcpp_lines_as_network(SEXP, SEXP, SEXP);
+extern SEXP _osmprob_rcpp_load_graph(SEXP);
 extern SEXP _osmprob_rcpp_make_compact_graph(SEXP, SEXP);
+extern SEXP _osmprob_rcpp_original_to_compact(SEXP, SEXP, SEXP, SEXP);
+extern SEXP _osmprob_rcpp_prepare_graph(SEXP, SEXP, SEXP, SEXP);
+extern SEXP _osmprob_rcpp_prepared_expand_path(SEXP, SEXP);
+extern SEXP _osmprob_rcpp_prepared_original_to_compact(SEXP);
+extern SEXP _osmprob_rcpp_prepared_path(SEXP, SEXP, SEXP, SEXP);
+extern SEXP _osmprob_rcpp_prepared_paths(SEXP, SEXP, SEXP, SEXP);
+extern SEXP _osmprob_rcpp_prepared_rsp(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP _osmprob_rcpp_read_osm(SEXP, SEXP);
 extern SEXP _osmprob_rcpp_router(SEXP, SEXP, SEXP, SEXP);
-extern SEXP _osmprob_rcpp_router_dijkstra(SEXP, SEXP, SEXP);
-extern SEXP _osmprob_rcpp_router_prob(SEXP, SEXP, SEXP, SEXP);
+extern SEXP _osmprob_rcpp_router_dijkstra(SEXP, SEXP, SEXP, SEXP);
+extern SEXP _osmprob_rcpp_router_dijkstra_batch(SEXP, SEXP, SEXP, SEXP);
+extern SEXP _osmprob_rcpp_router_prob(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP _osmprob_rcpp_router_rsp(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP _osmprob_rcpp_router_rsp_eta(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP _osmprob_rcpp_router_rsp_od(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP _osmprob_rcpp_save_graph(SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP _osmprob_rcpp_set_instrumentation(SEXP);
+extern SEXP _osmprob_rcpp_set_num_threads(SEXP);
+extern SEXP _osmprob_rcpp_vertex_index(SEXP);
 
 
 static const R_CallMethodDef CallEntries[] = {
-    {"_osmprob_rcpp_lines_as_network",   (DL_FUNC) &_osmprob_rcpp_lines_as_network,   2},
-    {"_osmprob_rcpp_make_compact_graph", (DL_FUNC) &_osmprob_rcpp_make_compact_graph, 2},
-    {"_osmprob_rcpp_router",             (DL_FUNC) &_osmprob_rcpp_router,             4},
-    {"_osmprob_rcpp_router_dijkstra",    (DL_FUNC) &_osmprob_rcpp_router_dijkstra,    3},
-    {"_osmprob_rcpp_router_prob",        (DL_FUNC) &_osmprob_rcpp_router_prob,        4},
+    {"_osmprob_rcpp_ch_build",                     (DL_FUNC) &_osmprob_rcpp_ch_build,                     4},
+    {"_osmprob_rcpp_ch_query",                     (DL_FUNC) &_osmprob_rcpp_ch_query,                     3},
+    {"_osmprob_rcpp_distance_matrix",              (DL_FUNC) &_osmprob_rcpp_distance_matrix,              3},
+    {"_osmprob_rcpp_expand_path",                  (DL_FUNC) &_osmprob_rcpp_expand_path,                  5},
+    {"_osmprob_rcpp_graph_nearest",                (DL_FUNC) &_osmprob_rcpp_graph_nearest,                4},
+    {"_osmprob_rcpp_index_nearest",                (DL_FUNC) &_osmprob_rcpp_index_nearest,                4},
+    {"_osmprob_rcpp_lines_as_network",             (DL_FUNC) &_osmprob_rcpp_lines_as_network,             3},
+    {"_osmprob_rcpp_load_graph",                   (DL_FUNC) &_osmprob_rcpp_load_graph,                   1},
+    {"_osmprob_rcpp_make_compact_graph",           (DL_FUNC) &_osmprob_rcpp_make_compact_graph,           2},
+    {"_osmprob_rcpp_original_to_compact",          (DL_FUNC) &_osmprob_rcpp_original_to_compact,          4},
+    {"_osmprob_rcpp_prepare_graph",                (DL_FUNC) &_osmprob_rcpp_prepare_graph,                4},
+    {"_osmprob_rcpp_prepared_expand_path",         (DL_FUNC) &_osmprob_rcpp_prepared_expand_path,         2},
+    {"_osmprob_rcpp_prepared_original_to_compact", (DL_FUNC) &_osmprob_rcpp_prepared_original_to_compact, 1},
+    {"_osmprob_rcpp_prepared_path",                (DL_FUNC) &_osmprob_rcpp_prepared_path,                4},
+    {"_osmprob_rcpp_prepared_paths",               (DL_FUNC) &_osmprob_rcpp_prepared_paths,               4},
+    {"_osmprob_rcpp_prepared_rsp",                 (DL_FUNC) &_osmprob_rcpp_prepared_rsp,                 6},
+    {"_osmprob_rcpp_read_osm",                     (DL_FUNC) &_osmprob_rcpp_read_osm,                     2},
+    {"_osmprob_rcpp_router",                       (DL_FUNC) &_osmprob_rcpp_router,                       4},
+    {"_osmprob_rcpp_router_dijkstra",              (DL_FUNC) &_osmprob_rcpp_router_dijkstra,              4},
+    {"_osmprob_rcpp_router_dijkstra_batch",        (DL_FUNC) &_osmprob_rcpp_router_dijkstra_batch,        4},
+    {"_osmprob_rcpp_router_prob",                  (DL_FUNC) &_osmprob_rcpp_router_prob,                  7},
+    {"_osmprob_rcpp_router_rsp",                   (DL_FUNC) &_osmprob_rcpp_router_rsp,                   7},
+    {"_osmprob_rcpp_router_rsp_eta",               (DL_FUNC) &_osmprob_rcpp_router_rsp_eta,               6},
+    {"_osmprob_rcpp_router_rsp_od",                (DL_FUNC) &_osmprob_rcpp_router_rsp_od,                6},
+    {"_osmprob_rcpp_save_graph",                   (DL_FUNC) &_osmprob_rcpp_save_graph,                   5},
+    {"_osmprob_rcpp_set_instrumentation",          (DL_FUNC) &_osmprob_rcpp_set_instrumentation,          1},
+    {"_osmprob_rcpp_set_num_threads",              (DL_FUNC) &_osmprob_rcpp_set_num_threads,              1},
+    {"_osmprob_rcpp_vertex_index",                 (DL_FUNC) &_osmprob_rcpp_vertex_index,                 1},
     {NULL, NULL, 0}
 };
 
@@ -0,0 +1,113 @@
+/***************************************************************************
+ *  Project:    osmprob
+ *  File:       parallel.h
+ *  Language:   C++
+ *
+ *  osmprob is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  osmprob is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  osm-router.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Parallel loops over batches of independent queries, with
+ *                  OpenMP dynamic scheduling so that idle threads take the
+ *                  next query as soon as they finish the last.
+ *
+ *  Limitations:    Loop bodies must not call the R API, and must write their
+ *                  results only to slots of their own query, so that results
+ *                  do not depend on scheduling. Without OpenMP all loops run
+ *                  serially.
+ *
+ *  Dependencies:       OpenMP (optional)
+ *
+ *  Compiler Options:   -std=c++11 $(SHLIB_OPENMP_CXXFLAGS)
+ ***************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <exception>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+inline int &thread_count ()
+{
+#ifdef _OPENMP
+    static int n = omp_get_num_procs ();
+#else
+    static int n = 1;
+#endif
+    return n;
+}
+
+inline int get_num_threads () { return thread_count (); }
+
+// Returns the previous number; n < 1 resets to the number of processors
+inline int set_num_threads (int n)
+{
+    const int prev = thread_count ();
+#ifdef _OPENMP
+    thread_count () = n < 1 ? omp_get_num_procs () : n;
+#endif
+    return prev;
+}
+
+inline int thread_id ()
+{
+#ifdef _OPENMP
+    return omp_get_thread_num ();
+#else
+    return 0;
+#endif
+}
+
+/* Calls body (i, worker) for each i in [0, n), where worker in
+ * [0, get_num_threads ()) identifies the calling thread, and so any scratch
+ * space it may use. The first exception thrown by any body is rethrown once
+ * all threads have finished, and no further bodies are started after it. */
+template <typename body_t>
+void parallel_for (size_t n, body_t body)
+{
+    std::atomic <bool> failed (false);
+    std::exception_ptr err = nullptr;
+
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic) num_threads(get_num_threads ())
+#endif
+    for (long i = 0; i < static_cast <long> (n); i++)
+    {
+        if (failed.load ())
+            continue;
+        try
+        {
+            body (static_cast <size_t> (i), thread_id ());
+        } catch (...)
+        {
+#ifdef _OPENMP
+            #pragma omp critical
+#endif
+            {
+                if (!failed.load ())
+                {
+                    err = std::current_exception ();
+                    failed.store (true);
+                }
+            }
+        }
+    }
+
+    if (err)
+        std::rethrow_exception (err);
+}
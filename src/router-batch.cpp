@@ -0,0 +1,244 @@
+/***************************************************************************
+ *  Project:    osmprob
+ *  File:       router-batch.cpp
+ *  Language:   C++
+ *
+ *  osmprob is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  osmprob is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  osm-router.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Multithreaded batches of shortest path queries, including
+ *                  distance matrices, and the thread count shared by all
+ *                  parallel routines.
+ *
+ *  Limitations:
+ *
+ *  Dependencies:       OpenMP (optional)
+ *
+ *  Compiler Options:   -std=c++11 $(SHLIB_OPENMP_CXXFLAGS)
+ ***************************************************************************/
+
+#include <Rcpp.h>
+
+#include "graph-csr.h"
+#include "dijkstra.h"
+#include "instrument.h"
+#include "parallel.h"
+
+//' rcpp_set_num_threads
+//'
+//' Set the number of threads used by all parallel routines
+//'
+//' @param n Number of threads; values < 1 reset to the number of processors
+//'
+//' @return The previous number of threads
+//'
+//' @noRd
+// [[Rcpp::export]]
+int rcpp_set_num_threads (int n)
+{
+    return set_num_threads (n);
+}
+
+//' rcpp_router_dijkstra_batch
+//'
+//' Shortest paths between many pairs of nodes, calculated in parallel
+//'
+//' @param netdf A \code{data.frame} with columns \code{from_id}, \code{to_id}
+//' and \code{d_weighted}
+//' @param start_nodes Starting nodes of each pair
+//' @param end_nodes Ending nodes of each pair
+//' @param method Either "bidirectional" or "early_exit", as for
+//' \code{rcpp_router_dijkstra}
+//'
+//' @return A list of the weighted distance (\code{d_weighted}) for each pair,
+//' infinite where unreachable, and of paths (\code{paths}) as vectors of
+//' node IDs, empty where unreachable.
+//'
+//' @noRd
+// [[Rcpp::export]]
+Rcpp::List rcpp_router_dijkstra_batch (Rcpp::DataFrame netdf,
+        std::vector <long long> start_nodes, std::vector <long long> end_nodes,
+        std::string method)
+{
+    if (start_nodes.size () != end_nodes.size ())
+        throw std::runtime_error ("start_nodes and end_nodes must have the "
+                "same length");
+    if (method != "bidirectional" && method != "early_exit")
+        throw std::runtime_error ("unknown shortest path method " + method);
+    const bool bidirectional = method == "bidirectional";
+
+    Rcpp::NumericVector idfrom_rcpp = netdf ["from_id"];
+    std::vector <vertex_t> idfrom =
+        Rcpp::as <std::vector <vertex_t> > (idfrom_rcpp);
+    Rcpp::NumericVector idto_rcpp = netdf ["to_id"];
+    std::vector <vertex_t> idto =
+        Rcpp::as <std::vector <vertex_t> > (idto_rcpp);
+    Rcpp::NumericVector d_rcpp = netdf ["d_weighted"];
+    std::vector <weight_t> d = Rcpp::as <std::vector <weight_t> > (d_rcpp);
+
+    Instrument instrument;
+    csr_graph_t g, g_rev;
+    {
+        ScopedTimer timer (instrument, "build_graph");
+        g.build (idfrom, idto, d);
+        if (bidirectional)
+            g_rev = g.reverse ();
+    }
+
+    const size_t npairs = start_nodes.size ();
+    std::vector <index_t> starts (npairs), ends (npairs);
+    for (size_t i = 0; i < npairs; i++)
+    {
+        starts [i] = g.vertex_index (start_nodes [i]);
+        ends [i] = g.vertex_index (end_nodes [i]);
+    }
+
+    // The graphs are shared read-only; each worker has its own search
+    // scratch and instrumentation, and each pair its own result slots.
+    const int nworkers = get_num_threads ();
+    std::vector <DijkstraSearch> searches (nworkers);
+    std::vector <BidirectionalDijkstra> bisearches (nworkers);
+    std::vector <Instrument> instruments (nworkers);
+    std::vector <weight_t> dist (npairs);
+    std::vector <std::vector <index_t> > paths (npairs);
+    {
+        ScopedTimer timer (instrument, bidirectional ? "bidirectional" :
+                "dijkstra");
+        parallel_for (npairs, [&] (size_t i, int worker)
+        {
+            if (bidirectional)
+            {
+                BidirectionalDijkstra &b = bisearches [worker];
+                b.run (g, g_rev, starts [i], ends [i]);
+                dist [i] = b.distance;
+                paths [i] = b.path ();
+                instruments [worker].count ("vertices_settled", b.nsettled ());
+                instruments [worker].count ("heap_operations", b.nheap_ops ());
+            } else
+            {
+                DijkstraSearch &s = searches [worker];
+                s.run (g, starts [i], ends [i]);
+                dist [i] = s.dist [ends [i]];
+                paths [i] = s.path_to (ends [i]);
+                instruments [worker].count ("vertices_settled", s.nsettled);
+                instruments [worker].count ("heap_operations", s.nheap_ops);
+            }
+        });
+    }
+    for (auto &i: instruments)
+        instrument.merge (i);
+
+    Rcpp::List paths_out (npairs);
+    for (size_t i = 0; i < npairs; i++)
+    {
+        Rcpp::NumericVector p (paths [i].size ());
+        for (size_t j = 0; j < paths [i].size (); j++)
+            p (j) = g.ids [paths [i] [j]];
+        paths_out [i] = p;
+    }
+
+    Rcpp::List res = Rcpp::List::create (Rcpp::Named ("d_weighted") = dist,
+            Rcpp::Named ("paths") = paths_out);
+    instrument.attach (res);
+    return res;
+}
+
+//' rcpp_distance_matrix
+//'
+//' Shortest distances between all pairs of two sets of nodes
+//'
+//' One search is run from each of \code{from_nodes}, in parallel, and each
+//' stops as soon as all of \code{to_nodes} have been reached.
+//'
+//' @param netdf A \code{data.frame} with character columns \code{from_id} and
+//' \code{to_id}, and numeric column \code{d}
+//' @param from_nodes IDs of starting nodes
+//' @param to_nodes IDs of ending nodes
+//'
+//' @return Matrix of distances with one row for each of \code{from_nodes} and
+//' one column for each of \code{to_nodes}, with \code{Inf} for unreachable
+//' pairs.
+//'
+//' @noRd
+// [[Rcpp::export]]
+Rcpp::NumericMatrix rcpp_distance_matrix (Rcpp::DataFrame netdf,
+        std::vector <std::string> from_nodes,
+        std::vector <std::string> to_nodes)
+{
+    Rcpp::CharacterVector idfrom = netdf ["from_id"];
+    Rcpp::CharacterVector idto = netdf ["to_id"];
+    Rcpp::NumericVector d_rcpp = netdf ["d"];
+    std::vector <weight_t> d = Rcpp::as <std::vector <weight_t> > (d_rcpp);
+
+    Instrument instrument;
+    string_ids_t ids;
+    csr_graph_t g;
+    {
+        ScopedTimer timer (instrument, "build_graph");
+        std::vector <vertex_t> from (idfrom.size ()), to (idto.size ());
+        for (int i = 0; i < idfrom.size (); i++)
+        {
+            from [i] = ids.intern (std::string (idfrom [i]));
+            to [i] = ids.intern (std::string (idto [i]));
+        }
+        // Interned IDs are consecutive from zero, so equal their dense
+        // indices
+        g.build (from, to, d);
+    }
+
+    const size_t nfrom = from_nodes.size (), nto = to_nodes.size ();
+    std::vector <index_t> sources (nfrom), targets (nto);
+    for (size_t i = 0; i < nfrom; i++)
+        sources [i] = ids.at (from_nodes [i]);
+    std::vector <char> is_target (g.nvertices (), 0);
+    size_t ntargets = 0;
+    for (size_t j = 0; j < nto; j++)
+    {
+        targets [j] = ids.at (to_nodes [j]);
+        if (!is_target [targets [j]])
+        {
+            is_target [targets [j]] = 1;
+            ntargets++;
+        }
+    }
+
+    Rcpp::NumericMatrix dmat (nfrom, nto);
+    double *dmat_ptr = dmat.begin ();
+    const int nworkers = get_num_threads ();
+    std::vector <DijkstraSearch> searches (nworkers);
+    std::vector <Instrument> instruments (nworkers);
+    {
+        ScopedTimer timer (instrument, "dijkstra");
+        parallel_for (nfrom, [&] (size_t i, int worker)
+        {
+            DijkstraSearch &s = searches [worker];
+            s.init (g, sources [i]);
+            size_t nreached = 0;
+            while (!s.finished () && nreached < ntargets)
+                if (is_target [s.settle_next (g)])
+                    nreached++;
+            for (size_t j = 0; j < nto; j++)
+                dmat_ptr [i + j * nfrom] = s.dist [targets [j]];
+            instruments [worker].count ("vertices_settled", s.nsettled);
+            instruments [worker].count ("heap_operations", s.nheap_ops);
+        });
+    }
+    for (auto &i: instruments)
+        instrument.merge (i);
+
+    instrument.attach (dmat);
+    return dmat;
+}
@@ -0,0 +1,136 @@
+/***************************************************************************
+ *  Project:    osmprob
+ *  File:       router-ch.cpp
+ *  Language:   C++
+ *
+ *  osmprob is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  osmprob is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  osm-router.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    R interface to contraction hierarchies, which are held as
+ *                  external pointers so they need only be built once.
+ *
+ *  Limitations:    External pointers do not survive serialisation, so
+ *                  hierarchies must be rebuilt in each R session.
+ *
+ *  Dependencies:       none
+ *
+ *  Compiler Options:   -std=c++11
+ ***************************************************************************/
+
+#include <Rcpp.h>
+
+#include "contraction-hierarchy.h"
+#include "graph-map.h"
+#include "instrument.h"
+
+struct ch_graph_t
+{
+    string_ids_t ids;
+    ContractionHierarchy ch;
+    CHQuery query;
+    // Original rows of each row of the compact graph
+    edge_expansion_t expansion;
+    // Timings and counters of the latest query
+    Instrument instrument;
+};
+
+//' rcpp_ch_build
+//'
+//' Build a contraction hierarchy for a compact graph
+//'
+//' @param netdf A \code{data.frame} with character columns \code{from_id} and
+//' \code{to_id}, and numeric columns \code{edge_id} and \code{d_weighted}
+//' @param original_edge_id Edge IDs of the original graph
+//' @param map_compact Compact edge IDs of the map between the two graphs
+//' @param map_original Original edge IDs of the map between the two graphs
+//'
+//' @return External pointer to the hierarchy
+//'
+//' @noRd
+// [[Rcpp::export]]
+SEXP rcpp_ch_build (Rcpp::DataFrame netdf,
+        std::vector <double> original_edge_id, std::vector <double> map_compact,
+        std::vector <double> map_original)
+{
+    Rcpp::CharacterVector from = netdf ["from_id"];
+    Rcpp::CharacterVector to = netdf ["to_id"];
+    Rcpp::NumericVector d_rcpp = netdf ["d_weighted"];
+    std::vector <weight_t> d = Rcpp::as <std::vector <weight_t> > (d_rcpp);
+
+    Rcpp::XPtr <ch_graph_t> chg (new ch_graph_t, true);
+    std::vector <vertex_t> idfrom (from.size ()), idto (to.size ());
+    for (int i = 0; i < from.size (); i++)
+    {
+        idfrom [i] = chg->ids.intern (std::string (from [i]));
+        idto [i] = chg->ids.intern (std::string (to [i]));
+    }
+
+    // Interned IDs are consecutive from zero, so equal their dense indices
+    csr_graph_t g;
+    g.build (idfrom, idto, d);
+    chg->ch.build (g);
+
+    Rcpp::NumericVector edge_id = netdf ["edge_id"];
+    chg->expansion.build (as_edge_ids (Rcpp::as <std::vector <double> >
+                (edge_id)), as_edge_ids (original_edge_id),
+            as_edge_ids (map_compact), as_edge_ids (map_original));
+
+    return chg;
+}
+
+//' rcpp_ch_query
+//'
+//' Shortest path from a contraction hierarchy
+//'
+//' @param ch External pointer returned from \code{rcpp_ch_build}
+//' @param start_node ID of starting node
+//' @param end_node ID of ending node
+//'
+//' @return \code{Rcpp::NumericVector} of the (1-based) rows of the original
+//' graph along the path, in order. Empty if \code{end_node} is unreachable.
+//'
+//' @noRd
+// [[Rcpp::export]]
+Rcpp::NumericVector rcpp_ch_query (SEXP ch, std::string start_node,
+        std::string end_node)
+{
+    Rcpp::XPtr <ch_graph_t> chg (ch);
+    if (chg.get () == NULL)
+        throw std::runtime_error ("contraction hierarchy is no longer valid; "
+                "it must be rebuilt in each R session");
+
+    if (!chg->ids.has (start_node))
+        throw std::runtime_error ("start_node is not part of netdf");
+    if (!chg->ids.has (end_node))
+        throw std::runtime_error ("end_node is not part of netdf");
+
+    chg->instrument.clear ();
+    std::vector <index_t> path, rows;
+    {
+        ScopedTimer timer (chg->instrument, "ch_query");
+        chg->query.run (chg->ch, chg->ids.at (start_node),
+                chg->ids.at (end_node), path);
+        chg->expansion.expand (path, rows);
+    }
+    chg->instrument.count ("vertices_settled", chg->query.nsettled ());
+    chg->instrument.count ("heap_operations", chg->query.nheap_ops ());
+
+    Rcpp::NumericVector res (rows.size ());
+    for (size_t i = 0; i < rows.size (); i++)
+        res (i) = rows [i] + 1;
+    chg->instrument.attach (res);
+    return res;
+}
@@ -43,54 +43,45 @@
 
 void Graphmp::make_dq_mats ()
 {
-    /* the diagonal of d_mat is 0, otherwise the first row contains only one
-     * finite entry for escape from start_node. The last column similarly
-     * contains only one finite entry for absorption by end_node. */
-    static const unsigned num_vertices = return_num_vertices ();
-    //const unsigned start_node = return_start_node ();
-    //const unsigned end_node = return_end_node ();
-    const unsigned dstart_node = std::distance (all_nodes.begin (),
-            all_nodes.find (return_start_node ()));
-    const unsigned dend_node = std::distance (all_nodes.begin (),
-            all_nodes.find (return_end_node ()));
-
-    d_mat = arma::mat (num_vertices + 1, num_vertices + 1);
-    d_mat.fill (max_weight);
-    d_mat.diag (0.0);
-    q_mat.zeros (num_vertices + 1, num_vertices + 1);
-
-    //unsigned q_sums [num_vertices] = {0}; // fails on travis
-    //unsigned q_sums [num_vertices]; // Note: 1 shorter than q_mat
-    unsigned *q_sums = new unsigned [num_vertices];
-    for (unsigned i=0; i<num_vertices; i++)
-        q_sums [i] = 0;
-
-    for (auto const &it1 : adjlist)
-    {
-        const unsigned di = std::distance (all_nodes.begin (), 
-                all_nodes.find (it1.first));
-        for (auto const &it2 : it1.second)
+    /* d_mat holds finite entries only on the edges, plus one entry in the first
+     * row for escape to start_node. All other entries of the former dense
+     * version were either 0 (diagonal) or non-finite, and both were reset to
+     * zero before use, so they need not be stored. q_mat has the identical
+     * sparsity pattern. */
+    const unsigned num_vertices = return_num_vertices ();
+    const unsigned dstart_node = graph.vertex_index (return_start_node ());
+    const unsigned dend_node = graph.vertex_index (return_end_node ());
+
+    std::vector <unsigned> q_sums (num_vertices, 0);
+    std::vector <triplet_t> d_trip, q_trip;
+    d_trip.reserve (graph.nedges () + 1);
+    q_trip.reserve (graph.nedges () + 1);
+
+    for (index_t di = 0; di < num_vertices; di++)
+        for (index_t k = graph.offsets [di]; k < graph.offsets [di + 1]; k++)
         {
-            const unsigned dj = std::distance (all_nodes.begin (),
-                    all_nodes.find (it2.target));
-            d_mat (di + 1, dj + 1) = it2.weight;
-            q_mat (di + 1, dj + 1) = 1.0;
+            const index_t dj = graph.targets [k];
+            d_trip.push_back (triplet_t (di + 1, dj + 1, graph.weights [k]));
+            q_trip.push_back (triplet_t (di + 1, dj + 1, 1.0));
             q_sums [di]++;
         }
-    }
+    d_trip.push_back (triplet_t (0, dstart_node + 1, 1.0));
+    q_trip.push_back (triplet_t (0, dstart_node + 1, 1.0));
 
-    d_mat (0, dstart_node + 1) = 1.0;
+    // Duplicated edges overwrote one another in the dense version, so the last
+    // one is retained here too.
+    auto last = [] (const double &, const double &b) { return b; };
+    d_mat.resize (num_vertices + 1, num_vertices + 1);
+    d_mat.setFromTriplets (d_trip.begin (), d_trip.end (), last);
+    q_mat.resize (num_vertices + 1, num_vertices + 1);
+    q_mat.setFromTriplets (q_trip.begin (), q_trip.end (), last);
 
     // Standardise q_mat, which is the top-left of the probability matrix
-    for (arma::uword r=1; r<q_mat.n_rows; ++r)
+    for (int r=1; r<q_mat.outerSize (); ++r)
         if (q_sums [r - 1] > 0) // == 0 if links to TO and not FROM
-            q_mat.row (r) = q_mat.row (r) / (double) q_sums [r - 1];
-    // Then add links to dstart_node and to absorbing end_node
-    q_mat (0, dstart_node + 1) = 1.0;
-    q_mat.row (dend_node + 1) = q_mat.row (dend_node + 1) * 
-        q_sums [dend_node] / (q_sums [dend_node] + 1.0);
-
-    delete [] q_sums;
+            q_mat.row (r) /= (double) q_sums [r - 1];
+    // Then add absorbing end_node
+    q_mat.row (dend_node + 1) *= q_sums [dend_node] / (q_sums [dend_node] + 1.0);
 }
 
 
@@ -104,13 +95,21 @@ void Graphmp::make_dq_mats ()
 
 void Graphmp::make_n_mat ()
 {
-    // The most computationally expensive part of all, and the only place
-    // requiring matrix inversion. This is, however, only required once, and is
-    // not repeated within the convergence loop.
+    // N = (I - Q)^{-1} is dense even when Q is sparse, so it is never formed.
+    // The sparse LU factors are computed once here, and each product N * y
+    // within the convergence loop is then a pair of triangular solves.
     const unsigned n = return_num_vertices ();
 
-    arma::mat unit_mat (n + 1, n + 1, arma::fill::eye);
-    n_mat = (unit_mat - q_mat).i();
+    sp_mat_col_t unit_mat (n + 1, n + 1);
+    unit_mat.setIdentity ();
+    sp_mat_col_t i_minus_q = unit_mat - sp_mat_col_t (q_mat);
+    i_minus_q.makeCompressed ();
+
+    n_lu.analyzePattern (i_minus_q);
+    n_lu.factorize (i_minus_q);
+    if (n_lu.info () != Eigen::Success)
+        throw std::runtime_error ("Factorisation of (I - Q) failed: " +
+                n_lu.lastErrorMessage ());
 }
 
 
@@ -124,18 +123,37 @@ void Graphmp::make_n_mat ()
 
 void Graphmp::make_hxv_vecs ()
 {
-    arma::mat lq = -arma::log (q_mat.t ());
-    // q_mat has zeros, so log (q) has non-finite values which are here reset to
-    // zero so they don't contribute to the resultant sums.
-    lq.elem (arma::find_nonfinite (lq)).zeros ();
-    arma::mat temp_mat = q_mat * lq; // arma requires this intermediate stage
-    h_vec = temp_mat.diag ();
-    x_vec = n_mat * h_vec;
-
-    arma::mat dtemp = d_mat;
-    dtemp.elem (arma::find_nonfinite (dtemp)).zeros ();
-    temp_mat = q_mat * dtemp.t ();
-    v_vec = n_mat * temp_mat.diag ();
+    // h_vec is the diagonal of Q * (-log Q)^T, and the right-hand side of
+    // v_vec the diagonal of Q * D^T. Both only involve the non-zero entries of
+    // each row of Q, which are aligned with those of D, and so are O(E) and
+    // independent between rows.
+    const int n = q_mat.outerSize ();
+    const double *qv = q_mat.valuePtr (), *dv = d_mat.valuePtr ();
+    const int *rp = q_mat.outerIndexPtr ();
+
+    // Columns are the right-hand sides of x_vec and v_vec, so that both are
+    // solved in one pass over the LU factors
+    hv_rhs.resize (n, 2);
+    double *h = hv_rhs.col (0).data (), *qd = hv_rhs.col (1).data ();
+    for_row_blocks (n, [&] (int begin, int end)
+    {
+        for (int r = begin; r < end; ++r)
+        {
+            double hr = 0.0, qdr = 0.0;
+            for (int k=rp [r]; k<rp [r + 1]; ++k)
+            {
+                hr -= qv [k] > 0.0 ? qv [k] * std::log (qv [k]) : 0.0;
+                qdr += qv [k] * dv [k];
+            }
+            h [r] = hr;
+            qd [r] = qdr;
+        }
+    });
+
+    hv_sol = n_lu.solve (hv_rhs);
+    h_vec = hv_rhs.col (0);
+    x_vec = hv_sol.col (0);
+    v_vec = hv_sol.col (1);
 }
 
 
@@ -149,28 +167,32 @@ void Graphmp::make_hxv_vecs ()
 
 void Graphmp::iterate_q_mat ()
 {
+    // Zero-valued entries of q_mat correspond to infinite costs, and so remain
+    // zero. Only stored entries need be updated, and the sparsity pattern is
+    // unchanged, so each row is updated and normalised independently.
     const double eta_inv = 1.0 / return_eta ();
-    const arma::rowvec x_row = arma::conv_to <arma::rowvec>::from (x_vec),
-          v_row = arma::conv_to <arma::rowvec>::from (v_vec);
-
-    // TODO: Use arma::sum to get row sums and avoid looping over rows?
-    // - this would require making matrices of x_vec and v_vec, so may not be
-    // any quicker?
-    q_mat.replace (0.0, max_weight);
-    for (arma::uword r=0; r<q_mat.n_rows; ++r)
+    const int n = q_mat.outerSize ();
+    const int *rp = q_mat.outerIndexPtr (), *ci = q_mat.innerIndexPtr ();
+    const double *xv = x_vec.data (), *vv = v_vec.data ();
+    double *qv = q_mat.valuePtr ();
+
+    for_row_blocks (n, [&] (int begin, int end)
     {
-        //arma::rowvec temp_row = q_mat.row (r);
-        //arma::rowvec temp_row = q_mat.row (r);
-        //temp_row.replace (0.0, max_weight);
-        //temp_row = arma::exp (-eta_inv * (temp_row + v_row) + x_row);
-        arma::rowvec temp_row = arma::exp (-eta_inv * (q_mat.row (r) + 
-                    v_row) + x_row);
-        const double rsum = arma::sum (temp_row);
-        if (rsum > 0.0)
-            q_mat.row (r) = temp_row / rsum;
-        else
-            q_mat.row (r) = temp_row.zeros ();
-    }
+        for (int r = begin; r < end; ++r)
+        {
+            double rsum = 0.0;
+            for (int k=rp [r]; k<rp [r + 1]; ++k)
+            {
+                const double q = std::exp (-eta_inv * (qv [k] + vv [ci [k]]) +
+                        xv [ci [k]]);
+                qv [k] = qv [k] > 0.0 ? q : 0.0;
+                rsum += qv [k];
+            }
+            const double rsum_inv = rsum > 0.0 ? 1.0 / rsum : 0.0;
+            for (int k=rp [r]; k<rp [r + 1]; ++k)
+                qv [k] *= rsum_inv;
+        }
+    });
 }
 
 /************************************************************************
@@ -181,21 +203,99 @@ void Graphmp::iterate_q_mat ()
  ************************************************************************
  ************************************************************************/
 
-unsigned Graphmp::calculate_q_mat (double tol, unsigned max_iter)
+/* Each iteration applies the fixed-point map G (q) = iterate_q_mat
+ * (make_hxv_vecs (q)) to the stored values q of q_mat, with residual
+ * f = G (q) - q. With memory > 0, Anderson acceleration then replaces G (q)
+ * with the combination of the last memory values of G which minimises the
+ * same combination of their residuals. The weights of that combination sum to
+ * one, so row sums remain those of G. Steps which would leave negative or
+ * non-finite entries are rejected in favour of G (q), and the history is
+ * restarted whenever a residual increases.
+ *
+ * Iteration stops once the L1 error in q is below tol, estimated from the
+ * residual r and contraction rate rho, as the largest ratio of the last few
+ * successive residuals, by the a posteriori bound r rho / (1 - rho), or by r
+ * itself until rho can be estimated. The ratio of two residuals only measures
+ * the contraction of G if the earlier of them was taken from a plain value of
+ * G; after an accelerated step it instead reflects the quality of the
+ * extrapolation, so rho is only estimated from runs of plain steps. */
+unsigned Graphmp::calculate_q_mat (double tol, unsigned max_iter,
+        unsigned memory)
 {
     unsigned nloops = 0; 
 
-    arma::mat q_mat_old;
-
-    double delta = 1.0;
-    while (delta > tol && nloops < max_iter)
+    const Eigen::Index nnz = q_mat.nonZeros ();
+    Eigen::Map <Eigen::VectorXd> q_vals (q_mat.valuePtr (), nnz);
+    Eigen::VectorXd q_old (nnz), f (nnz), g_prev, f_prev, q_acc;
+    // Differences between successive values of G and of the residuals, in a
+    // ring buffer of which the first nhist columns are filled
+    Eigen::MatrixXd dg (nnz, memory), df (nnz, memory);
+    unsigned nhist = 0, next = 0;
+    const size_t nrho = 3;
+
+    residuals.clear ();
+    // Whether the q of each iteration was replaced by an accelerated value
+    std::vector <bool> accelerated;
+    double err = 1.0;
+    while (err > tol && nloops < max_iter)
     {
-        q_mat_old = q_mat;
-        make_hxv_vecs ();
-        iterate_q_mat ();
-        delta = arma::accu (arma::abs (q_mat_old - q_mat));
+        q_old = q_vals;
+        {
+            ScopedTimer t (instrument, "make_hxv_vecs");
+            make_hxv_vecs ();
+        }
+        {
+            ScopedTimer t (instrument, "iterate_q_mat");
+            iterate_q_mat ();
+        }
+        f = q_vals - q_old;
+        const double delta = f.cwiseAbs ().sum ();
+        residuals.push_back (delta);
+        accelerated.push_back (false);
         nloops++;
+
+        err = delta;
+        if (residuals.size () > nrho)
+        {
+            double rho = 0.0;
+            bool plain = true;
+            for (size_t i = residuals.size () - nrho; i < residuals.size (); i++)
+            {
+                plain = plain && !accelerated [i - 1];
+                rho = std::max (rho, residuals [i] / residuals [i - 1]);
+            }
+            if (plain && rho < 1.0)
+                err = delta * rho / (1.0 - rho);
+        }
+        if (memory == 0 || err <= tol)
+            continue;
+
+        if (nloops > 1 && delta > residuals [nloops - 2])
+            nhist = next = 0;
+        else if (nloops > 1)
+        {
+            dg.col (next) = q_vals - g_prev;
+            df.col (next) = f - f_prev;
+            next = (next + 1) % memory;
+            nhist = std::min (nhist + 1, memory);
+        }
+        g_prev = q_vals;
+        f_prev = f;
+        if (nhist == 0)
+            continue;
+
+        const Eigen::VectorXd gamma =
+            df.leftCols (nhist).colPivHouseholderQr ().solve (f);
+        q_acc = q_vals - dg.leftCols (nhist) * gamma;
+        if (q_acc.allFinite () && q_acc.minCoeff () >= 0.0)
+        {
+            q_vals = q_acc;
+            accelerated.back () = true;
+        } else
+            nhist = next = 0;
     }
+    q_error = err;
+    instrument.count ("iterations", nloops);
 
     return nloops;
 }
@@ -242,26 +342,22 @@ Rcpp::NumericMatrix rcpp_router (Rcpp::DataFrame netdf,
 
     Graphmp g (idfrom, idto, d, start_node, end_node, eta);
 
-    int nloops = g.calculate_q_mat (1.0e-6, 1000000);
-    Rcpp::Rcout << "---converged in " << nloops << " loops" << std::endl;
-    std::vector <std::string> cnames = {"S", "0", "1", "2", "3", "4", "5", "E"};
-    // g.dumpMat (g.q_mat, "Q1", cnames);
+    g.calculate_q_mat (1.0e-6, 1000000);
 
-    std::vector <weight_t> min_distance;
-    std::vector <vertex_t> previous;
-    g.Dijkstra (start_node, min_distance, previous);
+    g.Dijkstra (start_node);
 
-    std::vector <vertex_t> path = g.GetShortestPathTo (end_node, previous);
+    std::vector <vertex_t> path = g.GetShortestPathTo (end_node);
     // Then fill distances from start to end nodes
     std::vector <weight_t> dout;
     dout.reserve (path.size ());
     for (unsigned i=0; i<path.size (); i++)
-        dout.push_back (min_distance [i + 1]);
+        dout.push_back (g.GetDistanceTo (path [i]));
 
     Rcpp::NumericMatrix res (path.size (), 2);
     std::copy (path.begin (), path.end (), res.begin ());
     std::copy (dout.begin (), dout.end (), res.begin () + path.size ());
 
+    g.instrument.attach (res);
     return res;
 }
 
@@ -273,14 +369,30 @@ Rcpp::NumericMatrix rcpp_router (Rcpp::DataFrame netdf,
 //' @param start_node Starting node for shortest path route
 //' @param end_node Ending node for shortest path route
 //' @param eta The entropy parameter
+//' @param method Either "fixed_point", for plain fixed-point iteration, or
+//' "anderson", for Anderson acceleration of the same iteration
+//' @param tol Tolerance of the estimated L1 error in the probabilities
+//' @param max_iter Maximal number of iterations
 //'
-//' @return Rcpp::NumericVector of traversing probabilities
+//' @return Rcpp::NumericVector of traversing probabilities, with attributes
+//' \code{iterations}, \code{residuals} (the L1 change in the probabilities
+//' of each iteration) and \code{converged}
 //'
 //' @noRd
 // [[Rcpp::export]]
 Rcpp::NumericVector rcpp_router_prob (Rcpp::DataFrame netdf,
-        long long start_node, long long end_node, double eta)
+        long long start_node, long long end_node, double eta,
+        std::string method = "fixed_point", double tol = 1.0e-6,
+        int max_iter = 1000000)
 {
+    unsigned memory = 0;
+    if (method == "anderson")
+        memory = anderson_memory;
+    else if (method != "fixed_point")
+        throw std::runtime_error ("unknown iteration method " + method);
+    if (max_iter < 0)
+        throw std::runtime_error ("max_iter must not be negative");
+
     // Extract vectors from netmat and convert to std:: types
     Rcpp::NumericVector idfrom_rcpp = netdf ["xfr"];
     std::vector <vertex_t> idfrom = 
@@ -295,34 +407,24 @@ Rcpp::NumericVector rcpp_router_prob (Rcpp::DataFrame netdf,
 
     Graphmp g (idfrom, idto, d, start_node, end_node, eta);
 
-    const unsigned max_iter = 1000000;
-    unsigned nloops = g.calculate_q_mat (1.0e-6, max_iter);
-    if (nloops > max_iter)
-        throw std::runtime_error ("Routing algorithm did not converge");
-    // q_mat then has to have first row and first col removed
-    const int s = g.q_mat.n_rows;
-    g.q_mat = g.q_mat.submat (1, 1, s - 1, s - 1);
-
-    // The OSM IDs are then inserted as row and col names, requiring conversion
-    // of arma::mat to Rcpp::NumericMatrix
-    Rcpp::NumericMatrix q_mat_out = 
-        Rcpp::as <Rcpp::NumericMatrix> (Rcpp::wrap (g.q_mat));
-    Rcpp::CharacterVector names;
-    for (auto i=g.all_nodes.begin (); i != g.all_nodes.end (); ++i)
-        names.push_back (std::to_string (*i));
-    Rcpp::rownames (q_mat_out) = names;
-    Rcpp::colnames (q_mat_out) = names;
-
-    // Finally, convert matrix to single vector matching the pairs of xfr,xto
-    Rcpp::NumericVector q_vec;
+    const unsigned nloops = g.calculate_q_mat (tol,
+            static_cast <unsigned> (max_iter), memory);
+    const bool converged = g.q_error <= tol;
+    if (!converged)
+        Rcpp::warning ("Routing algorithm did not converge");
+    // Convert q_mat to single vector matching the pairs of xfr,xto. The first
+    // row and column of q_mat are for escape to the start node.
+    Rcpp::NumericVector q_vec (idfrom.size ());
     for (unsigned i=0; i<idfrom.size (); i++)
     {
-        unsigned di = std::distance (g.all_nodes.begin (), 
-                g.all_nodes.find (idfrom [i]));
-        unsigned dj = std::distance (g.all_nodes.begin (), 
-                g.all_nodes.find (idto [i]));
-        q_vec.push_back (q_mat_out (di, dj));
+        const index_t di = g.graph.vertex_index (idfrom [i]);
+        const index_t dj = g.graph.vertex_index (idto [i]);
+        q_vec (i) = g.q_mat.coeff (di + 1, dj + 1);
     }
+    q_vec.attr ("iterations") = nloops;
+    q_vec.attr ("residuals") = g.residuals;
+    q_vec.attr ("converged") = converged;
+    g.instrument.attach (q_vec);
     return q_vec;
 }
 
@@ -333,13 +435,21 @@ Rcpp::NumericVector rcpp_router_prob (Rcpp::DataFrame netdf,
 //' @param netdf A \code{data.frame} containing network connections
 //' @param start_node Starting node for shortest path route
 //' @param end_node Ending node for shortest path route
+//' @param method One of "bidirectional" (simultaneous searches from both
+//' start and end nodes), "early_exit" (search from start node only until the
+//' end node is reached), "astar" (as for "early_exit", but directed towards the
+//' end node by its great circle distance), or "full" (search the entire graph
+//' from the start node)
+//'
+//' @note Method "astar" requires \code{netdf} to also have columns \code{d},
+//' \code{from_lon}, \code{from_lat}, \code{to_lon} and \code{to_lat}.
 //'
 //' @return \code{Rcpp::NumericVector} with node IDs
 //'
 //' @noRd
 // [[Rcpp::export]]
 Rcpp::NumericVector rcpp_router_dijkstra (Rcpp::DataFrame netdf, 
-        int start_node, int end_node)
+        int start_node, int end_node, std::string method)
 {
     // Extract vectors from netmat and convert to std:: types
     Rcpp::NumericVector idfrom_rcpp = netdf ["from_id"];
@@ -358,10 +468,45 @@ Rcpp::NumericVector rcpp_router_dijkstra (Rcpp::DataFrame netdf,
 
     Graphmp g (idfrom, idto, d, start_nodei, end_nodei);
 
-    std::vector <weight_t> min_distance;
-    std::vector <vertex_t> previous;
-    g.Dijkstra (start_nodei, min_distance, previous);
+    std::vector <vertex_t> path;
+    if (method == "bidirectional")
+    {
+        weight_t dist;
+        path = g.BidirectionalPath (start_nodei, end_nodei, dist);
+    } else if (method == "early_exit")
+    {
+        g.DijkstraTo (start_nodei, end_nodei);
+        path = g.GetShortestPathTo (end_nodei);
+    } else if (method == "astar")
+    {
+        Rcpp::NumericVector dist_rcpp = netdf ["d"];
+        std::vector <weight_t> dist =
+            Rcpp::as <std::vector <weight_t> > (dist_rcpp);
+        Rcpp::NumericVector from_lon = netdf ["from_lon"],
+            from_lat = netdf ["from_lat"], to_lon = netdf ["to_lon"],
+            to_lat = netdf ["to_lat"];
+        const index_t n = g.graph.nvertices ();
+        std::vector <double> lon (n), lat (n);
+        for (size_t i = 0; i < idfrom.size (); i++)
+        {
+            const index_t fi = g.graph.vertex_index (idfrom [i]),
+                  ti = g.graph.vertex_index (idto [i]);
+            lon [fi] = from_lon [i];
+            lat [fi] = from_lat [i];
+            lon [ti] = to_lon [i];
+            lat [ti] = to_lat [i];
+        }
+        const double factor = HaversineHeuristic::min_weight_factor (dist, d);
+        g.AStarTo (start_nodei, end_nodei, lon, lat, factor);
+        path = g.GetShortestPathTo (end_nodei);
+    } else if (method == "full")
+    {
+        g.Dijkstra (start_nodei);
+        path = g.GetShortestPathTo (end_nodei);
+    } else
+        throw std::runtime_error ("unknown shortest path method " + method);
 
-    std::vector <vertex_t> path = g.GetShortestPathTo (end_nodei, previous);
-    return Rcpp::wrap (path);
+    Rcpp::NumericVector res = Rcpp::wrap (path);
+    g.instrument.attach (res);
+    return res;
 }
@@ -40,22 +40,47 @@
 #include <algorithm>
 #include <iterator>
 
-#include <RcppArmadillo.h>
-// [[Rcpp::depends(RcppArmadillo)]]
+#include <RcppEigen.h>
+// [[Rcpp::depends(RcppEigen)]]
 
-typedef long long vertex_t;
-typedef double weight_t;
+#include "graph-csr.h"
+#include "dijkstra.h"
+#include "astar.h"
+#include "instrument.h"
+#include "parallel.h"
+
+// Row-major so that the row-wise loops of make_hxv_vecs and iterate_q_mat run
+// over contiguous memory. The LU factorisation itself requires column-major.
+typedef Eigen::SparseMatrix <double, Eigen::RowMajor> sp_mat_t;
+typedef Eigen::SparseMatrix <double> sp_mat_col_t;
+typedef Eigen::Triplet <double> triplet_t;
 
 const weight_t max_weight = std::numeric_limits <weight_t>::infinity();
 
-struct neighbor {
-    vertex_t target;
-    weight_t weight;
-    neighbor (vertex_t arg_target, weight_t arg_weight)
-        : target (arg_target), weight (arg_weight) { }
-};
+// Number of previous iterates combined by Anderson acceleration
+const unsigned anderson_memory = 5;
 
-typedef std::map <vertex_t, std::vector <neighbor> > adjacency_list_t;
+// Rows of q_mat per parallel block of make_hxv_vecs and iterate_q_mat
+const size_t mp_block_size = 1 << 12;
+
+/* Calls body (begin, end) for consecutive blocks of the n rows of q_mat. Blocks
+ * run in parallel only if there are several, so that the many iterations on
+ * small graphs are not dominated by starting threads. */
+template <typename body_t>
+void for_row_blocks (int n, body_t body)
+{
+    const size_t nblocks = (n + mp_block_size - 1) / mp_block_size;
+    if (nblocks < 2)
+    {
+        body (0, n);
+        return;
+    }
+    parallel_for (nblocks, [&] (size_t b, int)
+    {
+        body (static_cast <int> (b * mp_block_size),
+                std::min (n, static_cast <int> ((b + 1) * mp_block_size)));
+    });
+}
 
 class Graphmp
 {
@@ -67,10 +92,30 @@ class Graphmp
         unsigned _num_vertices;
 
     public:
-        std::set <vertex_t> all_nodes;
-        adjacency_list_t adjlist; // the graph data
-        arma::mat d_mat, q_mat, n_mat; // <double>
-        arma::vec h_vec, x_vec, v_vec; // also <double>
+        // The graph data, with vertices densely indexed in ascending order of
+        // ID. Row/col (i + 1) of d_mat and q_mat is dense vertex i.
+        csr_graph_t graph;
+        // Shortest-path scratch, retained between calls to Dijkstra
+        DijkstraSearch shortest;
+        // Reverse graph, only constructed for bidirectional searches
+        csr_graph_t graph_rev;
+        BidirectionalDijkstra bidirectional;
+        // d_mat and q_mat share an identical sparsity pattern (edges only), so
+        // their valuePtr () arrays are aligned entry for entry.
+        sp_mat_t d_mat, q_mat;
+        // Sparse LU of (I - Q), used in place of the dense inverse N
+        Eigen::SparseLU <sp_mat_col_t, Eigen::COLAMDOrdering <int> > n_lu;
+        Eigen::VectorXd h_vec, x_vec, v_vec;
+        // Right-hand sides and solutions of (I - Q) [x v] = [h Q.D], reused
+        // between iterations
+        Eigen::MatrixXd hv_rhs, hv_sol;
+        // Timings of each phase, and counts of vertices settled, heap
+        // operations and iterations
+        Instrument instrument;
+        // L1 change in q_mat of each iteration of calculate_q_mat, and the
+        // estimated L1 error of the final q_mat
+        std::vector <double> residuals;
+        double q_error;
 
         Graphmp (std::vector <vertex_t> idfrom, std::vector <vertex_t> idto,
                 std::vector <weight_t> d, vertex_t start_node,
@@ -78,8 +123,12 @@ class Graphmp
             : _idfrom (idfrom), _idto (idto), _d (d),
                 _start_node (start_node), _end_node (end_node), _eta (eta)
         {
-            _num_vertices = fillGraph (); // fills adjlist with (idfrom, idto, d)
-            make_dq_mats ();
+            _num_vertices = fillGraph (); // fills graph with (idfrom, idto, d)
+            {
+                ScopedTimer t (instrument, "make_dq_mats");
+                make_dq_mats ();
+            }
+            ScopedTimer t (instrument, "make_n_mat");
             make_n_mat ();
         }
 
@@ -100,26 +149,37 @@ class Graphmp
         unsigned return_num_vertices() { return _num_vertices;   }
         vertex_t return_start_node() { return _start_node;   }
         vertex_t return_end_node() { return _end_node;   }
-        std::vector <vertex_t> return_idfrom() { return _idfrom; }
-        std::vector <vertex_t> return_idto() { return _idto; }
-        std::vector <weight_t> return_d() { return _d; }
+        const std::vector <vertex_t> &return_idfrom() { return _idfrom; }
+        const std::vector <vertex_t> &return_idto() { return _idto; }
+        const std::vector <weight_t> &return_d() { return _d; }
         double return_eta() { return _eta;  }
 
         unsigned fillGraph ();
         void dumpGraph ();
-        void dumpMat (arma::mat mat, std::string mat_name,
+        void dumpMat (const sp_mat_t &mat, std::string mat_name,
                 std::vector <std::string> cnames);
-        void Dijkstra (vertex_t source, 
-                std::vector <weight_t> &min_distance,
-                std::vector <vertex_t> &previous);
-        std::vector <vertex_t> GetShortestPathTo (vertex_t vertex, 
-                const std::vector <vertex_t> &previous);
+        void Dijkstra (vertex_t source);
+        void DijkstraTo (vertex_t source, vertex_t target);
+        void AStarTo (vertex_t source, vertex_t target,
+                const std::vector <double> &lon,
+                const std::vector <double> &lat, double factor);
+        std::vector <vertex_t> GetShortestPathTo (vertex_t vertex);
+        weight_t GetDistanceTo (vertex_t vertex);
+        std::vector <vertex_t> BidirectionalPath (vertex_t source,
+                vertex_t target, weight_t &distance);
+        void count_search (size_t nsettled, size_t nheap_ops)
+        {
+            instrument.count ("vertices_settled", nsettled);
+            instrument.count ("heap_operations", nheap_ops);
+        }
 
         void make_dq_mats ();
         void make_n_mat ();
         void make_hxv_vecs ();
         void iterate_q_mat ();
-        unsigned calculate_q_mat (double tol, unsigned max_iter);
+        // memory > 0 for Anderson acceleration over that many iterations
+        unsigned calculate_q_mat (double tol, unsigned max_iter,
+                unsigned memory = 0);
 };
 
 
@@ -133,44 +193,30 @@ class Graphmp
 
 unsigned Graphmp::fillGraph ()
 {
-    std::vector <vertex_t> idfrom = return_idfrom ();
-    std::vector <vertex_t> idto = return_idto ();
-    std::vector <weight_t> d = return_d ();
-    std::vector <neighbor> nblist;
+    ScopedTimer t (instrument, "fillGraph");
+    graph.build (return_idfrom (), return_idto (), return_d ());
 
-    for (unsigned i=0; i<idfrom.size (); i++)
-    {
-        all_nodes.insert (idfrom [i]);
-        if (adjlist.find (idfrom [i]) != adjlist.end ())
-        {
-            nblist = adjlist [idfrom [i]];
-            adjlist.erase (idfrom [i]);
-        }
-        nblist.push_back (neighbor (idto [i], d [i]));
-        adjlist.insert (std::make_pair (idfrom [i], nblist));
-        all_nodes.insert (idto [i]);
-        nblist.clear ();
-    }
-
-    return all_nodes.size ();
+    return graph.nvertices ();
 }
 
 void Graphmp::dumpGraph ()
 {
-    for (auto const &it1 : adjlist)
-        for (auto const &it2 : it1.second)
-            Rcpp::Rcout << "[" << it1.first << "] (" <<
-                it2.target << ", " << it2.weight << ")" << std::endl;
+    for (index_t u = 0; u < graph.nvertices (); u++)
+        for (index_t k = graph.offsets [u]; k < graph.offsets [u + 1]; k++)
+            Rcpp::Rcout << "[" << graph.ids [u] << "] (" <<
+                graph.ids [graph.targets [k]] << ", " << graph.weights [k] <<
+                ")" << std::endl;
 }
 
-void Graphmp::dumpMat (arma::mat mat, std::string mat_name,
+void Graphmp::dumpMat (const sp_mat_t &mat, std::string mat_name,
         std::vector <std::string> cnames)
 {
     Rcpp::Rcout << "------  " << mat_name << "_MAT  ------" << std::endl;
     Rcpp::Rcout << "        ";
     for (auto i : cnames)
         Rcpp::Rcout << i << "       ";
-    Rcpp::Rcout << std::endl << mat << std::endl;
+    // Only ever used for debugging small graphs, so densify for printing
+    Rcpp::Rcout << std::endl << Eigen::MatrixXd (mat) << std::endl;
 }
 
 
@@ -182,44 +228,64 @@ void Graphmp::dumpMat (arma::mat mat, std::string mat_name,
  ************************************************************************
  ************************************************************************/
 
-void Graphmp::Dijkstra (vertex_t source,
-        std::vector <weight_t> &min_distance,
-        std::vector <vertex_t> &previous)
+// Distances and predecessors are held in shortest, indexed by dense vertex
+// index. source is an ID.
+void Graphmp::Dijkstra (vertex_t source)
 {
-    int n = adjlist.size();
-    min_distance.clear();
-    min_distance.resize (n, max_weight);
-    min_distance [source] = 0;
-    previous.clear();
-    previous.resize (n, -1);
-    std::set <std::pair <weight_t, vertex_t> > vertex_queue;
-    vertex_queue.insert (std::make_pair (min_distance [source], source));
-
-    while (!vertex_queue.empty()) 
-    {
-        weight_t dist = vertex_queue.begin()->first;
-        vertex_t u = vertex_queue.begin()->second;
-        vertex_queue.erase (vertex_queue.begin());
-
-        // Visit each edge exiting u
-        const std::vector <neighbor> &neighbors = adjlist [u];
-        for (std::vector <neighbor>::const_iterator neighbor_iter = neighbors.begin();
-                neighbor_iter != neighbors.end(); neighbor_iter++)
-        {
-            vertex_t v = neighbor_iter->target;
-            weight_t weight = neighbor_iter->weight;
-            weight_t distance_through_u = dist + weight;
-            if (distance_through_u < min_distance [v]) {
-                vertex_queue.erase (std::make_pair (min_distance [v], v));
+    ScopedTimer t (instrument, "dijkstra");
+    shortest.run (graph, graph.vertex_index (source));
+    count_search (shortest.nsettled, shortest.nheap_ops);
+}
 
-                min_distance [v] = distance_through_u;
-                previous [v] = u;
-                vertex_queue.insert (std::make_pair (min_distance [v], v));
+// Stops once target is settled, after which GetShortestPathTo (target) and
+// GetDistanceTo (target) are the same as for the full search.
+void Graphmp::DijkstraTo (vertex_t source, vertex_t target)
+{
+    ScopedTimer t (instrument, "dijkstra");
+    shortest.run (graph, graph.vertex_index (source),
+            graph.vertex_index (target));
+    count_search (shortest.nsettled, shortest.nheap_ops);
+}
 
-            }
+// lon and lat are per dense vertex, and factor is the smallest ratio of edge
+// weight to distance. Results are then read as for DijkstraTo.
+void Graphmp::AStarTo (vertex_t source, vertex_t target,
+        const std::vector <double> &lon, const std::vector <double> &lat,
+        double factor)
+{
+    ScopedTimer timer (instrument, "astar");
+    const index_t t = graph.vertex_index (target);
+    HaversineHeuristic heuristic (lon, lat, factor, t);
+    shortest.run_astar (graph, graph.vertex_index (source), t, heuristic);
+    count_search (shortest.nsettled, shortest.nheap_ops);
+}
 
-        }
-    }
+/************************************************************************
+ ************************************************************************
+ **                                                                    **
+ **                         BIDIRECTIONALPATH                          **
+ **                                                                    **
+ ************************************************************************
+ ************************************************************************/
+
+// Returns the path as vertex IDs, or an empty path if target is unreachable,
+// in which case distance is infinite.
+std::vector <vertex_t> Graphmp::BidirectionalPath (vertex_t source,
+        vertex_t target, weight_t &distance)
+{
+    ScopedTimer t (instrument, "bidirectional");
+    if (graph_rev.nvertices () != graph.nvertices ())
+        graph_rev = graph.reverse ();
+    bidirectional.run (graph, graph_rev, graph.vertex_index (source),
+            graph.vertex_index (target));
+    distance = bidirectional.distance;
+    count_search (bidirectional.nsettled (), bidirectional.nheap_ops ());
+
+    std::vector <index_t> path = bidirectional.path ();
+    std::vector <vertex_t> path_ids (path.size ());
+    for (size_t i = 0; i < path.size (); i++)
+        path_ids [i] = graph.ids [path [i]];
+    return path_ids;
 }
 
 /************************************************************************
@@ -230,13 +296,18 @@ void Graphmp::Dijkstra (vertex_t source,
  ************************************************************************
  ************************************************************************/
 
-std::vector <vertex_t> Graphmp::GetShortestPathTo (vertex_t vertex, 
-        const std::vector <vertex_t> &previous)
+// Returns the path from the latest Dijkstra source as vertex IDs, or an empty
+// path if vertex is unreachable
+std::vector <vertex_t> Graphmp::GetShortestPathTo (vertex_t vertex)
 {
-    std::vector <vertex_t> path;
-    for ( ; vertex != -1; vertex = previous [vertex])
-        path.push_back (vertex);
-    std::reverse (path.begin(), path.end());
-    return path;
+    std::vector <index_t> path = shortest.path_to (graph.vertex_index (vertex));
+    std::vector <vertex_t> path_ids (path.size ());
+    for (size_t i = 0; i < path.size (); i++)
+        path_ids [i] = graph.ids [path [i]];
+    return path_ids;
 }
 
+weight_t Graphmp::GetDistanceTo (vertex_t vertex)
+{
+    return shortest.dist [graph.vertex_index (vertex)];
+}
@@ -0,0 +1,420 @@
+/***************************************************************************
+ *  Project:    osmprob
+ *  File:       router-prepared.cpp
+ *  Language:   C++
+ *
+ *  osmprob is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  osmprob is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  osm-router.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Compact graphs prepared once for routing and held as
+ *                  external pointers, so that each query only costs the
+ *                  routing itself rather than the conversion of the
+ *                  data.frame and construction of the graph.
+ *
+ *  Limitations:    External pointers do not survive serialisation, so
+ *                  prepared graphs must be rebuilt in each R session, and
+ *                  whenever the graph itself changes.
+ *
+ *  Dependencies:       Eigen (via RcppEigen), OpenMP (optional)
+ *
+ *  Compiler Options:   -std=c++11 $(SHLIB_OPENMP_CXXFLAGS)
+ ***************************************************************************/
+
+#include <memory>
+
+#include <RcppEigen.h>
+// [[Rcpp::depends(RcppEigen)]]
+
+#include "graph-csr.h"
+#include "dijkstra.h"
+#include "astar.h"
+#include "router-rsp.h"
+#include "graph-map.h"
+#include "parallel.h"
+
+/* Everything a query needs that depends only on the graph. Search scratch is
+ * retained too, so repeated queries do not reallocate it, and the matrices of
+ * the probabilistic router are built on the first probability query. */
+struct prepared_graph_t
+{
+    // Interned IDs are consecutive from zero, so equal dense indices
+    string_ids_t ids;
+    csr_graph_t graph, graph_rev;
+    // Per compact edge, for the probabilistic router
+    std::vector <index_t> from, to;
+    std::vector <weight_t> d, d_weighted;
+    // Per dense vertex; empty if the graph has no coordinates
+    std::vector <double> lon, lat;
+    double astar_factor;
+    // From compact edges to the original edges which they replace
+    edge_expansion_t expansion;
+
+    DijkstraSearch shortest;
+    BidirectionalDijkstra bidirectional;
+    std::vector <DijkstraSearch> searches;
+    std::vector <BidirectionalDijkstra> bisearches;
+    std::unique_ptr <GraphRSP> rsp;
+    // Timings and counters of the latest shortest path query
+    Instrument instrument;
+
+    index_t start_index (const std::string &id) const
+    {
+        if (!ids.has (id))
+            throw std::runtime_error ("start_node is not part of netdf");
+        return ids.at (id);
+    }
+    index_t end_index (const std::string &id) const
+    {
+        if (!ids.has (id))
+            throw std::runtime_error ("end_node is not part of netdf");
+        return ids.at (id);
+    }
+};
+
+prepared_graph_t &prepared_graph (SEXP pg)
+{
+    Rcpp::XPtr <prepared_graph_t> p (pg);
+    if (p.get () == NULL)
+        throw std::runtime_error ("prepared graph is no longer valid; "
+                "it must be rebuilt in each R session");
+    return *p;
+}
+
+// Vertex IDs along a path of dense indices
+Rcpp::CharacterVector path_ids (const prepared_graph_t &p,
+        const std::vector <index_t> &path)
+{
+    Rcpp::CharacterVector ids (path.size ());
+    for (size_t i = 0; i < path.size (); i++)
+        ids [i] = p.ids.names [path [i]];
+    return ids;
+}
+
+//' rcpp_prepare_graph
+//'
+//' Prepare a compact graph for repeated routing queries
+//'
+//' @param netdf A \code{data.frame} with character columns \code{from_id} and
+//' \code{to_id}, numeric columns \code{edge_id}, \code{d} and
+//' \code{d_weighted}, and optionally \code{from_lon}, \code{from_lat},
+//' \code{to_lon} and \code{to_lat} for "astar" searches
+//' @param original_edge_id Edge IDs of the original graph
+//' @param map_compact Compact edge IDs of the map between the two graphs
+//' @param map_original Original edge IDs of the map between the two graphs
+//'
+//' @return External pointer to the prepared graph
+//'
+//' @noRd
+// [[Rcpp::export]]
+SEXP rcpp_prepare_graph (Rcpp::DataFrame netdf,
+        std::vector <double> original_edge_id, std::vector <double> map_compact,
+        std::vector <double> map_original)
+{
+    Rcpp::CharacterVector idfrom = netdf ["from_id"];
+    Rcpp::CharacterVector idto = netdf ["to_id"];
+
+    Rcpp::XPtr <prepared_graph_t> p (new prepared_graph_t, true);
+    const size_t nedges = idfrom.size ();
+    p->from.resize (nedges);
+    p->to.resize (nedges);
+    std::vector <vertex_t> from (nedges), to (nedges);
+    for (size_t i = 0; i < nedges; i++)
+    {
+        from [i] = p->from [i] = p->ids.intern (std::string (idfrom [i]));
+        to [i] = p->to [i] = p->ids.intern (std::string (idto [i]));
+    }
+    Rcpp::NumericVector d_rcpp = netdf ["d"];
+    Rcpp::NumericVector w_rcpp = netdf ["d_weighted"];
+    p->d = Rcpp::as <std::vector <weight_t> > (d_rcpp);
+    p->d_weighted = Rcpp::as <std::vector <weight_t> > (w_rcpp);
+    Rcpp::NumericVector edge_id = netdf ["edge_id"];
+    p->expansion.build (as_edge_ids (Rcpp::as <std::vector <double> >
+                (edge_id)), as_edge_ids (original_edge_id),
+            as_edge_ids (map_compact), as_edge_ids (map_original));
+
+    p->graph.build (from, to, p->d_weighted);
+    p->graph_rev = p->graph.reverse ();
+
+    p->astar_factor = HaversineHeuristic::min_weight_factor (p->d,
+            p->d_weighted);
+    if (netdf.containsElementNamed ("from_lon"))
+    {
+        Rcpp::NumericVector from_lon = netdf ["from_lon"],
+            from_lat = netdf ["from_lat"], to_lon = netdf ["to_lon"],
+            to_lat = netdf ["to_lat"];
+        const index_t n = p->graph.nvertices ();
+        p->lon.resize (n);
+        p->lat.resize (n);
+        for (size_t i = 0; i < nedges; i++)
+        {
+            p->lon [from [i]] = from_lon [i];
+            p->lat [from [i]] = from_lat [i];
+            p->lon [to [i]] = to_lon [i];
+            p->lat [to [i]] = to_lat [i];
+        }
+    }
+
+    return p;
+}
+
+//' rcpp_prepared_path
+//'
+//' Shortest path on a prepared graph
+//'
+//' @param pg External pointer returned from \code{rcpp_prepare_graph}
+//' @param start_node ID of starting node
+//' @param end_node ID of ending node
+//' @param method One of "bidirectional", "early_exit", "astar" or "full", as
+//' for \code{rcpp_router_dijkstra}
+//'
+//' @return \code{Rcpp::CharacterVector} of node IDs along the path, empty if
+//' \code{end_node} is unreachable
+//'
+//' @noRd
+// [[Rcpp::export]]
+Rcpp::CharacterVector rcpp_prepared_path (SEXP pg, std::string start_node,
+        std::string end_node, std::string method)
+{
+    prepared_graph_t &p = prepared_graph (pg);
+    const index_t s = p.start_index (start_node), t = p.end_index (end_node);
+    p.instrument.clear ();
+
+    std::vector <index_t> path;
+    if (method == "bidirectional")
+    {
+        {
+            ScopedTimer timer (p.instrument, "bidirectional");
+            p.bidirectional.run (p.graph, p.graph_rev, s, t);
+        }
+        p.instrument.count ("vertices_settled", p.bidirectional.nsettled ());
+        p.instrument.count ("heap_operations", p.bidirectional.nheap_ops ());
+        path = p.bidirectional.path ();
+    } else if (method == "early_exit" || method == "full")
+    {
+        {
+            ScopedTimer timer (p.instrument, "dijkstra");
+            p.shortest.run (p.graph, s, method == "full" ? no_vertex : t);
+        }
+        p.instrument.count ("vertices_settled", p.shortest.nsettled);
+        p.instrument.count ("heap_operations", p.shortest.nheap_ops);
+        path = p.shortest.path_to (t);
+    } else if (method == "astar")
+    {
+        if (p.lon.empty ())
+            throw std::runtime_error ("graph was prepared without "
+                    "coordinates, which astar requires");
+        HaversineHeuristic heuristic (p.lon, p.lat, p.astar_factor, t);
+        {
+            ScopedTimer timer (p.instrument, "astar");
+            p.shortest.run_astar (p.graph, s, t, heuristic);
+        }
+        p.instrument.count ("vertices_settled", p.shortest.nsettled);
+        p.instrument.count ("heap_operations", p.shortest.nheap_ops);
+        path = p.shortest.path_to (t);
+    } else
+        throw std::runtime_error ("unknown shortest path method " + method);
+
+    Rcpp::CharacterVector res = path_ids (p, path);
+    p.instrument.attach (res);
+    return res;
+}
+
+//' rcpp_prepared_paths
+//'
+//' Shortest paths between many pairs of nodes on a prepared graph, calculated
+//' in parallel
+//'
+//' @param pg External pointer returned from \code{rcpp_prepare_graph}
+//' @param start_nodes Starting nodes of each pair
+//' @param end_nodes Ending nodes of each pair
+//' @param method Either "bidirectional" or "early_exit"
+//'
+//' @return A list of the weighted distance (\code{d_weighted}) for each pair,
+//' infinite where unreachable, and of paths (\code{paths}) as vectors of
+//' node IDs, empty where unreachable.
+//'
+//' @noRd
+// [[Rcpp::export]]
+Rcpp::List rcpp_prepared_paths (SEXP pg,
+        std::vector <std::string> start_nodes,
+        std::vector <std::string> end_nodes, std::string method)
+{
+    if (start_nodes.size () != end_nodes.size ())
+        throw std::runtime_error ("start_nodes and end_nodes must have the "
+                "same length");
+    if (method != "bidirectional" && method != "early_exit")
+        throw std::runtime_error ("unknown shortest path method " + method);
+    const bool bidirectional = method == "bidirectional";
+
+    prepared_graph_t &p = prepared_graph (pg);
+    const size_t npairs = start_nodes.size ();
+    std::vector <index_t> starts (npairs), ends (npairs);
+    for (size_t i = 0; i < npairs; i++)
+    {
+        starts [i] = p.start_index (start_nodes [i]);
+        ends [i] = p.end_index (end_nodes [i]);
+    }
+
+    const size_t nworkers = get_num_threads ();
+    if (p.searches.size () < nworkers)
+    {
+        p.searches.resize (nworkers);
+        p.bisearches.resize (nworkers);
+    }
+    p.instrument.clear ();
+    std::vector <Instrument> instruments (nworkers);
+    std::vector <weight_t> dist (npairs);
+    std::vector <std::vector <index_t> > paths (npairs);
+    {
+        ScopedTimer timer (p.instrument, bidirectional ? "bidirectional" :
+                "dijkstra");
+        parallel_for (npairs, [&] (size_t i, int worker)
+        {
+            if (bidirectional)
+            {
+                BidirectionalDijkstra &b = p.bisearches [worker];
+                b.run (p.graph, p.graph_rev, starts [i], ends [i]);
+                dist [i] = b.distance;
+                paths [i] = b.path ();
+                instruments [worker].count ("vertices_settled", b.nsettled ());
+                instruments [worker].count ("heap_operations", b.nheap_ops ());
+            } else
+            {
+                DijkstraSearch &s = p.searches [worker];
+                s.run (p.graph, starts [i], ends [i]);
+                dist [i] = s.dist [ends [i]];
+                paths [i] = s.path_to (ends [i]);
+                instruments [worker].count ("vertices_settled", s.nsettled);
+                instruments [worker].count ("heap_operations", s.nheap_ops);
+            }
+        });
+    }
+    for (auto &i: instruments)
+        p.instrument.merge (i);
+
+    Rcpp::List paths_out (npairs);
+    for (size_t i = 0; i < npairs; i++)
+        paths_out [i] = path_ids (p, paths [i]);
+
+    Rcpp::List res = Rcpp::List::create (Rcpp::Named ("d_weighted") = dist,
+            Rcpp::Named ("paths") = paths_out);
+    p.instrument.attach (res);
+    return res;
+}
+
+//' rcpp_prepared_rsp
+//'
+//' Randomised shortest path densities and probabilities on a prepared graph
+//'
+//' The sparsity pattern of (I - W), and the symbolic factorisation of the
+//' direct solver, are retained between queries.
+//'
+//' @param pg External pointer returned from \code{rcpp_prepare_graph}
+//' @inheritParams rcpp_router_rsp
+//'
+//' @return A list of edge traversal densities (\code{dens}) and probabilities
+//' (\code{prob}), both matching the rows of the \code{data.frame} from which
+//' the graph was prepared, and the total probabilistic distance
+//' (\code{dist}).
+//'
+//' @noRd
+// [[Rcpp::export]]
+Rcpp::List rcpp_prepared_rsp (SEXP pg, std::string start_node,
+        std::string end_node, double eta, std::string solver = "direct",
+        double tol = 1.0e-10)
+{
+    prepared_graph_t &p = prepared_graph (pg);
+    const index_t s = p.start_index (start_node), t = p.end_index (end_node);
+
+    if (!p.rsp)
+        p.rsp.reset (new GraphRSP (p.ids.names.size (), p.from, p.to,
+                    p.d_weighted, p.d));
+    p.rsp->instrument.clear ();
+    p.rsp->set_solver (rsp_solver_type (solver), tol);
+    p.rsp->set_weights (eta, t);
+    p.rsp->factorise ();
+    rsp_result_t result;
+    p.rsp->solve (s, result);
+
+    Rcpp::List res = Rcpp::List::create (Rcpp::Named ("dens") = result.dens,
+            Rcpp::Named ("prob") = result.prob,
+            Rcpp::Named ("dist") = result.dist);
+    p.rsp->instrument.attach (res);
+    return res;
+}
+
+//' rcpp_prepared_expand_path
+//'
+//' Edges of the original graph along a path through a prepared compact graph
+//'
+//' @param pg External pointer returned from \code{rcpp_prepare_graph}
+//' @param path IDs of vertices of the compact graph along the path
+//'
+//' @return (1-based) rows of the original graph along the path, in order
+//'
+//' @noRd
+// [[Rcpp::export]]
+Rcpp::IntegerVector rcpp_prepared_expand_path (SEXP pg,
+        std::vector <std::string> path)
+{
+    prepared_graph_t &p = prepared_graph (pg);
+
+    // The lightest of any parallel edges, as taken by the shortest path
+    std::vector <index_t> compact_rows (path.empty () ? 0 : path.size () - 1);
+    for (size_t i = 1; i < path.size (); i++)
+    {
+        const index_t u = p.ids.at (path [i - 1]), v = p.ids.at (path [i]);
+        index_t best = no_edge;
+        for (index_t k = p.graph.offsets [u]; k < p.graph.offsets [u + 1]; k++)
+            if (p.graph.targets [k] == v && (best == no_edge ||
+                        p.graph.weights [k] < p.graph.weights [best]))
+                best = k;
+        if (best == no_edge)
+            throw std::runtime_error ("path from " + path [i - 1] + " to " +
+                    path [i] + " is not part of the compact graph");
+        compact_rows [i - 1] = p.graph.edge_index [best];
+    }
+
+    std::vector <index_t> rows;
+    p.expansion.expand (compact_rows, rows);
+
+    Rcpp::IntegerVector res (rows.size ());
+    for (size_t i = 0; i < rows.size (); i++)
+        res [i] = rows [i] + 1;
+    return res;
+}
+
+//' rcpp_prepared_original_to_compact
+//'
+//' Edges of a prepared compact graph which replace each edge of the original
+//' graph
+//'
+//' @param pg External pointer returned from \code{rcpp_prepare_graph}
+//'
+//' @return (1-based) row of the compact graph for each row of the original
+//' graph, or \code{NA} for original edges not part of the compact graph
+//'
+//' @noRd
+// [[Rcpp::export]]
+Rcpp::IntegerVector rcpp_prepared_original_to_compact (SEXP pg)
+{
+    const edge_expansion_t &e = prepared_graph (pg).expansion;
+    Rcpp::IntegerVector res (e.compact_row.size ());
+    for (size_t i = 0; i < e.compact_row.size (); i++)
+        res [i] = e.compact_row [i] == no_edge ? NA_INTEGER :
+            e.compact_row [i] + 1;
+    return res;
+}
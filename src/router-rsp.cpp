@@ -0,0 +1,568 @@
+/***************************************************************************
+ *  Project:    osmprob
+ *  File:       router-rsp.cpp
+ *  Language:   C++
+ *
+ *  osmprob is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  osmprob is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  osm-router.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Randomised shortest path probabilities, replacing the
+ *                  Matrix-based R implementation in r_router_prob.
+ *
+ *  Limitations:
+ *
+ *  Dependencies:       RcppEigen
+ *
+ *  Compiler Options:   -std=c++11
+ ***************************************************************************/
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include <memory>
+
+#include <RcppEigen.h>
+// [[Rcpp::depends(RcppEigen)]]
+
+#include "router-rsp.h"
+#include "parallel.h"
+
+GraphRSP::GraphRSP (index_t nv, const std::vector <index_t> &from,
+        const std::vector <index_t> &to, const std::vector <weight_t> &c,
+        const std::vector <weight_t> &d)
+    : _nv (nv), _dest (0), _solver (rsp_direct), _analysed (false),
+        _warm_start (false)
+{
+    std::vector <Eigen::Triplet <double> > triplets;
+    triplets.reserve (from.size () + nv);
+    for (index_t i = 0; i < nv; i++)
+        triplets.push_back (Eigen::Triplet <double> (i, i, 0.0));
+    for (size_t e = 0; e < from.size (); e++)
+        triplets.push_back (Eigen::Triplet <double> (from [e], to [e], 0.0));
+    // Only the pattern is needed here; duplicates collapse to single entries
+    i_minus_w.resize (nv, nv);
+    i_minus_w.setFromTriplets (triplets.begin (), triplets.end ());
+    i_minus_w.makeCompressed ();
+
+    const index_t nnz = i_minus_w.nonZeros ();
+    _row.resize (nnz);
+    _col.resize (nnz);
+    for (index_t j = 0; j < nv; j++)
+        for (int k = i_minus_w.outerIndexPtr () [j];
+                k < i_minus_w.outerIndexPtr () [j + 1]; k++)
+        {
+            _row [k] = i_minus_w.innerIndexPtr () [k];
+            _col [k] = j;
+        }
+
+    // Entries which are not edges (the diagonal, except for self-loops) have
+    // infinite cost, and so zero probability and weight.
+    _c.assign (nnz, std::numeric_limits <weight_t>::infinity ());
+    _d.assign (nnz, 0.0);
+    _edge_pos.resize (from.size ());
+    const int *inner = i_minus_w.innerIndexPtr ();
+    for (size_t e = 0; e < from.size (); e++)
+    {
+        const int *first = inner + i_minus_w.outerIndexPtr () [to [e]];
+        const int *last = inner + i_minus_w.outerIndexPtr () [to [e] + 1];
+        const index_t k = std::lower_bound (first, last,
+                static_cast <int> (from [e])) - inner;
+        _edge_pos [e] = k;
+        _c [k] = c [e];
+        _d [k] = d [e];
+    }
+
+    // Transition probabilities proportional to 1 / c, normalised over rows
+    _p.resize (nnz);
+    std::vector <double> row_sums (nv, 0.0);
+    for (index_t k = 0; k < nnz; k++)
+    {
+        _p [k] = 1.0 / _c [k];
+        row_sums [_row [k]] += _p [k];
+    }
+    for (index_t k = 0; k < nnz; k++)
+        if (row_sums [_row [k]] > 0.0)
+            _p [k] /= row_sums [_row [k]];
+
+    _w.resize (nnz);
+    _e.setZero (nv);
+}
+
+void GraphRSP::set_solver (rsp_solver_t solver, double tol)
+{
+    _solver = solver;
+    _ilut.setTolerance (tol);
+    _ilut_t.setTolerance (tol);
+    _jacobi.setTolerance (tol);
+    _jacobi_t.setTolerance (tol);
+}
+
+void GraphRSP::set_guess (const Eigen::VectorXd &z1, const Eigen::VectorXd &zn)
+{
+    if (z1.size () != _nv || zn.size () != _nv)
+        throw std::runtime_error ("initial guesses must have one value "
+                "for each vertex");
+    _z1 = z1;
+    _zn = zn;
+    _warm_start = true;
+}
+
+void GraphRSP::set_weights (double eta, index_t dest)
+{
+    _dest = dest;
+    _zn_current = false;
+    double *a = i_minus_w.valuePtr ();
+    for (size_t k = 0; k < _w.size (); k++)
+    {
+        _w [k] = std::exp (-eta * _c [k]) * _p [k];
+        if (!std::isfinite (_w [k]) || _row [k] == dest)
+            _w [k] = 0.0;
+        a [k] = (_row [k] == _col [k] ? 1.0 : 0.0) - _w [k];
+    }
+}
+
+void GraphRSP::factorise ()
+{
+    ScopedTimer t (instrument, "factorise");
+    instrument.count ("factorisations", 1);
+    _zn_current = false;
+    if (_solver != rsp_direct)
+    {
+        i_minus_w_t = i_minus_w.transpose ();
+        bool ok;
+        if (_solver == rsp_bicgstab_ilut)
+        {
+            _ilut.compute (i_minus_w);
+            _ilut_t.compute (i_minus_w_t);
+            ok = _ilut.info () == Eigen::Success &&
+                _ilut_t.info () == Eigen::Success;
+        } else
+        {
+            _jacobi.compute (i_minus_w);
+            _jacobi_t.compute (i_minus_w_t);
+            ok = _jacobi.info () == Eigen::Success &&
+                _jacobi_t.info () == Eigen::Success;
+        }
+        if (!ok)
+            throw std::runtime_error ("Preconditioning of (I - W) failed");
+        return;
+    }
+
+    // The pattern never changes, so the symbolic analysis is only done once
+    if (!_analysed)
+    {
+        _lu.analyzePattern (i_minus_w);
+        _analysed = true;
+    }
+    _lu.factorize (i_minus_w);
+    if (_lu.info () != Eigen::Success)
+        throw std::runtime_error ("Factorisation of (I - W) failed: " +
+                _lu.lastErrorMessage ());
+}
+
+template <typename S>
+void GraphRSP::solve_iterative (S &solver, const Eigen::VectorXd &b,
+        Eigen::VectorXd &x)
+{
+    if (_warm_start)
+        x = solver.solveWithGuess (b, x);
+    else
+        x = solver.solve (b);
+    instrument.count ("bicgstab_iterations", solver.iterations ());
+    if (solver.info () != Eigen::Success)
+        throw std::runtime_error ("BiCGSTAB did not converge to the "
+                "requested tolerance");
+}
+
+void GraphRSP::solve_dest ()
+{
+    if (_zn_current)
+        return;
+    _e [_dest] = 1.0;
+    if (_solver == rsp_direct)
+        _zn = _lu.solve (_e);
+    else if (_solver == rsp_bicgstab_ilut)
+        solve_iterative (_ilut, _e, _zn);
+    else
+        solve_iterative (_jacobi, _e, _zn);
+    _e [_dest] = 0.0;
+    _zn_current = true;
+}
+
+void GraphRSP::solve (index_t start, rsp_result_t &result)
+{
+    {
+        ScopedTimer t (instrument, "solve");
+        solve_dest ();
+
+        _e [start] = 1.0;
+        if (_solver == rsp_direct)
+            _z1 = _lu.transpose ().solve (_e);
+        else if (_solver == rsp_bicgstab_ilut)
+            solve_iterative (_ilut_t, _e, _z1);
+        else
+            solve_iterative (_jacobi_t, _e, _z1);
+        _e [start] = 0.0;
+        _warm_start = _solver != rsp_direct;
+    }
+
+    ScopedTimer t (instrument, "edge_results");
+    edge_results (start, result);
+}
+
+void GraphRSP::solve (const std::vector <index_t> &starts,
+        std::vector <rsp_result_t> &results)
+{
+    results.resize (starts.size ());
+    if (_solver != rsp_direct)
+    {
+        for (size_t i = 0; i < starts.size (); i++)
+            solve (starts [i], results [i]);
+        return;
+    }
+
+    {
+        ScopedTimer t (instrument, "solve");
+        solve_dest ();
+    }
+    // Blocks of right-hand sides for the transposed solve, so that each
+    // pass over the LU factors serves several starts
+    const size_t block = 32;
+    Eigen::MatrixXd e, z1;
+    for (size_t i0 = 0; i0 < starts.size (); i0 += block)
+    {
+        const size_t nb = std::min (block, starts.size () - i0);
+        e.setZero (_nv, nb);
+        for (size_t j = 0; j < nb; j++)
+            e (starts [i0 + j], j) = 1.0;
+        {
+            ScopedTimer t (instrument, "solve");
+            z1 = _lu.transpose ().solve (e);
+        }
+        ScopedTimer t (instrument, "edge_results");
+        for (size_t j = 0; j < nb; j++)
+        {
+            _z1 = z1.col (j);
+            edge_results (starts [i0 + j], results [i0 + j]);
+        }
+    }
+}
+
+void GraphRSP::edge_results (index_t start, rsp_result_t &result)
+{
+    const size_t nedges = _edge_pos.size ();
+    const double z1n = _zn [start];
+    if (!(z1n > 1.0e-300))
+    {
+        result.dens.assign (nedges, NA_REAL);
+        result.prob.assign (nedges, NA_REAL);
+        result.dist = 0.0;
+        return;
+    }
+
+    // Densities N = diag (z1) W diag (zn) / z1n, on stored entries only
+    const size_t nnz = _w.size ();
+    std::vector <double> n_vals (nnz), n_rows (_nv, 0.0), n_cols (_nv, 0.0);
+    double dist = 0.0;
+    for (size_t k = 0; k < nnz; k++)
+    {
+        const double zwz = _z1 [_row [k]] * _w [k] * _zn [_col [k]];
+        n_vals [k] = zwz / z1n;
+        n_rows [_row [k]] += n_vals [k];
+        n_cols [_col [k]] += n_vals [k];
+        dist += zwz * _d [k];
+    }
+    result.dist = dist / z1n;
+
+    result.dens.resize (nedges);
+    result.prob.resize (nedges);
+    for (size_t e = 0; e < nedges; e++)
+    {
+        const index_t k = _edge_pos [e];
+        const double n = std::max (n_rows [_row [k]], n_cols [_row [k]]);
+        result.dens [e] = n_vals [k];
+        result.prob [e] = n > 0.0 ? n_vals [k] / n : 0.0;
+    }
+}
+
+// Intern the character IDs of netdf as dense vertex indices
+void rsp_vertices (Rcpp::DataFrame netdf, string_ids_t &ids,
+        std::vector <index_t> &from, std::vector <index_t> &to)
+{
+    Rcpp::CharacterVector idfrom = netdf ["xfr"];
+    Rcpp::CharacterVector idto = netdf ["xto"];
+    from.resize (idfrom.size ());
+    to.resize (idto.size ());
+    for (int i = 0; i < idfrom.size (); i++)
+    {
+        from [i] = ids.intern (std::string (idfrom [i]));
+        to [i] = ids.intern (std::string (idto [i]));
+    }
+}
+
+rsp_solver_t rsp_solver_type (const std::string &solver)
+{
+    if (solver == "ilut")
+        return rsp_bicgstab_ilut;
+    else if (solver == "jacobi")
+        return rsp_bicgstab_jacobi;
+    else if (solver != "direct")
+        throw std::runtime_error ("unknown solver " + solver);
+    return rsp_direct;
+}
+
+//' rcpp_router_rsp
+//'
+//' Randomised shortest path densities and probabilities
+//'
+//' @param netdf A \code{data.frame} with character columns \code{xfr} and
+//' \code{xto}, and numeric columns \code{d} and \code{d_weighted}
+//' @param start_node Starting node for the route
+//' @param end_node Ending node for the route
+//' @param eta The entropy parameter
+//' @param solver One of "direct" (sparse LU), "ilut" or "jacobi" (BiCGSTAB
+//' with incomplete LU or diagonal preconditioning)
+//' @param tol Relative residual tolerance for the iterative solvers
+//' @param guess Optional list of initial \code{z1} and \code{zn} for the
+//' iterative solvers, as returned from a previous call on the same
+//' \code{netdf}
+//'
+//' @return A list of edge traversal densities (\code{dens}) and probabilities
+//' (\code{prob}), both matching the rows of \code{netdf}, the total
+//' probabilistic distance (\code{dist}), and the solution vectors \code{z1}
+//' and \code{zn}.
+//'
+//' @noRd
+// [[Rcpp::export]]
+Rcpp::List rcpp_router_rsp (Rcpp::DataFrame netdf, std::string start_node,
+        std::string end_node, double eta, std::string solver = "direct",
+        double tol = 1.0e-10, Rcpp::Nullable <Rcpp::List> guess = R_NilValue)
+{
+    Rcpp::NumericVector d_rcpp = netdf ["d"];
+    Rcpp::NumericVector c_rcpp = netdf ["d_weighted"];
+
+    string_ids_t ids;
+    std::vector <index_t> from, to;
+    rsp_vertices (netdf, ids, from, to);
+    if (!ids.has (start_node))
+        throw std::runtime_error ("start_node is not part of netdf");
+    if (!ids.has (end_node))
+        throw std::runtime_error ("end_node is not part of netdf");
+
+    GraphRSP g (ids.names.size (), from, to,
+            Rcpp::as <std::vector <weight_t> > (c_rcpp),
+            Rcpp::as <std::vector <weight_t> > (d_rcpp));
+    g.set_solver (rsp_solver_type (solver), tol);
+    if (guess.isNotNull ())
+    {
+        Rcpp::List z (guess);
+        g.set_guess (Rcpp::as <Eigen::VectorXd> (z ["z1"]),
+                Rcpp::as <Eigen::VectorXd> (z ["zn"]));
+    }
+
+    g.set_weights (eta, ids.at (end_node));
+    g.factorise ();
+    rsp_result_t result;
+    g.solve (ids.at (start_node), result);
+
+    Rcpp::List res = Rcpp::List::create (Rcpp::Named ("dens") = result.dens,
+            Rcpp::Named ("prob") = result.prob,
+            Rcpp::Named ("dist") = result.dist,
+            Rcpp::Named ("z1") = g.z1 (),
+            Rcpp::Named ("zn") = g.zn ());
+    g.instrument.attach (res);
+    return res;
+}
+
+//' rcpp_router_rsp_eta
+//'
+//' Randomised shortest path densities and probabilities for a sequence of
+//' entropy parameters
+//'
+//' The sparsity pattern of (I - W), and its symbolic factorisation, are
+//' shared between all values of eta, and each iterative solve starts from the
+//' solution for the previous value.
+//'
+//' @inheritParams rcpp_router_rsp
+//' @param eta Vector of entropy parameters, best in ascending or descending
+//' order for the iterative solvers
+//'
+//' @return A list of matrices of edge traversal densities (\code{dens}) and
+//' probabilities (\code{prob}), with rows matching the rows of \code{netdf}
+//' and columns matching \code{eta}, and a vector of the total probabilistic
+//' distances (\code{dist}) for each \code{eta}.
+//'
+//' @noRd
+// [[Rcpp::export]]
+Rcpp::List rcpp_router_rsp_eta (Rcpp::DataFrame netdf, std::string start_node,
+        std::string end_node, std::vector <double> eta,
+        std::string solver = "direct", double tol = 1.0e-10)
+{
+    Rcpp::NumericVector d_rcpp = netdf ["d"];
+    Rcpp::NumericVector c_rcpp = netdf ["d_weighted"];
+
+    string_ids_t ids;
+    std::vector <index_t> from, to;
+    rsp_vertices (netdf, ids, from, to);
+    if (!ids.has (start_node))
+        throw std::runtime_error ("start_node is not part of netdf");
+    if (!ids.has (end_node))
+        throw std::runtime_error ("end_node is not part of netdf");
+
+    GraphRSP g (ids.names.size (), from, to,
+            Rcpp::as <std::vector <weight_t> > (c_rcpp),
+            Rcpp::as <std::vector <weight_t> > (d_rcpp));
+    g.set_solver (rsp_solver_type (solver), tol);
+
+    const size_t nedges = from.size ();
+    Rcpp::NumericMatrix dens (nedges, eta.size ()), prob (nedges, eta.size ());
+    Rcpp::NumericVector dist (eta.size ());
+    rsp_result_t result;
+    for (size_t i = 0; i < eta.size (); i++)
+    {
+        g.set_weights (eta [i], ids.at (end_node));
+        g.factorise ();
+        g.solve (ids.at (start_node), result);
+        std::copy (result.dens.begin (), result.dens.end (),
+                dens.begin () + i * nedges);
+        std::copy (result.prob.begin (), result.prob.end (),
+                prob.begin () + i * nedges);
+        dist (i) = result.dist;
+    }
+
+    Rcpp::List res = Rcpp::List::create (Rcpp::Named ("dens") = dens,
+            Rcpp::Named ("prob") = prob,
+            Rcpp::Named ("dist") = dist);
+    g.instrument.attach (res);
+    return res;
+}
+
+//' rcpp_router_rsp_od
+//'
+//' Randomised shortest path probabilities for many origin-destination pairs
+//'
+//' Pairs are grouped by destination, with one factorisation of (I - W) for
+//' each group, and groups are processed in parallel.
+//'
+//' @inheritParams rcpp_router_rsp
+//' @param start_nodes Starting nodes of each pair
+//' @param end_nodes Ending nodes of each pair
+//'
+//' @return A list of a matrix of edge traversal probabilities (\code{prob}),
+//' with rows matching the rows of \code{netdf} and one column for each pair,
+//' and a vector of the total probabilistic distances (\code{dist}) for each
+//' pair.
+//'
+//' @noRd
+// [[Rcpp::export]]
+Rcpp::List rcpp_router_rsp_od (Rcpp::DataFrame netdf,
+        std::vector <std::string> start_nodes,
+        std::vector <std::string> end_nodes, double eta,
+        std::string solver = "direct", double tol = 1.0e-10)
+{
+    if (start_nodes.size () != end_nodes.size ())
+        throw std::runtime_error ("start_nodes and end_nodes must have the "
+                "same length");
+
+    Rcpp::NumericVector d_rcpp = netdf ["d"];
+    Rcpp::NumericVector c_rcpp = netdf ["d_weighted"];
+
+    Instrument instrument;
+    string_ids_t ids;
+    std::vector <index_t> from, to;
+    rsp_vertices (netdf, ids, from, to);
+
+    const size_t npairs = start_nodes.size ();
+    std::vector <index_t> starts (npairs), ends (npairs);
+    for (size_t i = 0; i < npairs; i++)
+    {
+        if (!ids.has (start_nodes [i]))
+            throw std::runtime_error ("start_node " + start_nodes [i] +
+                    " is not part of netdf");
+        if (!ids.has (end_nodes [i]))
+            throw std::runtime_error ("end_node " + end_nodes [i] +
+                    " is not part of netdf");
+        starts [i] = ids.at (start_nodes [i]);
+        ends [i] = ids.at (end_nodes [i]);
+    }
+
+    // Pair indices ordered by destination, with groups of the same
+    // destination starting at group_offsets
+    std::vector <size_t> order (npairs);
+    for (size_t i = 0; i < npairs; i++)
+        order [i] = i;
+    std::stable_sort (order.begin (), order.end (),
+            [&ends] (size_t a, size_t b) { return ends [a] < ends [b]; });
+    std::vector <size_t> group_offsets;
+    for (size_t i = 0; i < npairs; i++)
+        if (i == 0 || ends [order [i]] != ends [order [i - 1]])
+            group_offsets.push_back (i);
+    group_offsets.push_back (npairs);
+
+    const index_t nv = ids.names.size ();
+    const std::vector <weight_t> c = Rcpp::as <std::vector <weight_t> > (c_rcpp);
+    const std::vector <weight_t> d = Rcpp::as <std::vector <weight_t> > (d_rcpp);
+    const rsp_solver_t solver_type = rsp_solver_type (solver);
+
+    const size_t nedges = from.size ();
+    Rcpp::NumericMatrix prob (nedges, npairs);
+    Rcpp::NumericVector dist (npairs);
+    double *prob_ptr = prob.begin (), *dist_ptr = dist.begin ();
+
+    // Groups are processed in parallel, each by one worker with its own
+    // matrices, built on first use
+    std::vector <std::unique_ptr <GraphRSP> > workers (get_num_threads ());
+    parallel_for (group_offsets.size () - 1,
+            [&] (size_t grp, int worker)
+    {
+        if (!workers [worker])
+        {
+            workers [worker].reset (new GraphRSP (nv, from, to, c, d));
+            workers [worker]->set_solver (solver_type, tol);
+        }
+        GraphRSP &g = *workers [worker];
+
+        const size_t i0 = group_offsets [grp], i1 = group_offsets [grp + 1];
+        std::vector <index_t> group_starts;
+        for (size_t i = i0; i < i1; i++)
+            group_starts.push_back (starts [order [i]]);
+
+        // Iterative solves must not depend on whichever group this worker
+        // happened to solve last
+        g.clear_guess ();
+        g.set_weights (eta, ends [order [i0]]);
+        g.factorise ();
+        std::vector <rsp_result_t> results;
+        g.solve (group_starts, results);
+        for (size_t j = 0; j < results.size (); j++)
+        {
+            const size_t pair = order [i0 + j];
+            std::copy (results [j].prob.begin (), results [j].prob.end (),
+                    prob_ptr + pair * nedges);
+            dist_ptr [pair] = results [j].dist;
+        }
+    });
+
+    for (auto &w: workers)
+        if (w)
+            instrument.merge (w->instrument);
+
+    Rcpp::List res = Rcpp::List::create (Rcpp::Named ("prob") = prob,
+            Rcpp::Named ("dist") = dist);
+    instrument.attach (res);
+    return res;
+}
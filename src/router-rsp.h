@@ -0,0 +1,142 @@
+/***************************************************************************
+ *  Project:    osmprob
+ *  File:       router-rsp.h
+ *  Language:   C++
+ *
+ *  osmprob is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  osmprob is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  osm-router.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Randomised shortest paths (Saerens et al. 2009), as
+ *                  adapted from gdistance and previously implemented in R as
+ *                  r_router_prob. Everything is computed on the edges of the
+ *                  graph only, from a single sparse LU factorisation of
+ *                  (I - W) which serves both the forward and transposed
+ *                  solves.
+ *
+ *  Limitations:    Edge weights must be positive. GMRES is not offered,
+ *                  as it is only in Eigen's unsupported modules.
+ *
+ *  Dependencies:       Eigen (via RcppEigen), Rcpp (for instrumentation)
+ *
+ *  Compiler Options:   -std=c++11
+ ***************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <RcppEigen.h>
+// [[Rcpp::depends(RcppEigen)]]
+
+#include <Eigen/Sparse>
+#include <Eigen/IterativeLinearSolvers>
+
+#include "graph-csr.h"
+#include "instrument.h"
+
+typedef Eigen::SparseMatrix <double> sp_mat_col_t;
+
+/* The direct solver is exact but the LU factors of (I - W) fill in on large
+ * graphs; the iterative solvers (preconditioned BiCGSTAB) only ever need
+ * memory linear in the number of edges, and converge to a given tolerance. */
+enum rsp_solver_t { rsp_direct, rsp_bicgstab_ilut, rsp_bicgstab_jacobi };
+
+// From the names "direct", "ilut" and "jacobi"; throws for any other name
+rsp_solver_t rsp_solver_type (const std::string &solver);
+
+struct rsp_result_t
+{
+    // Per input edge; both NA if the destination is unreachable
+    std::vector <double> dens, prob;
+    // Expected distance, 0 if the destination is unreachable
+    double dist;
+};
+
+class GraphRSP
+{
+    private:
+        index_t _nv;
+        /* i_minus_w holds one entry per distinct (from, to) pair plus the
+         * full diagonal, so its pattern is independent of eta and of the
+         * destination. The vectors below are aligned with its valuePtr ().
+         * Where edges are duplicated, the last one wins, as for the Matrix
+         * assignments of r_router_prob. */
+        sp_mat_col_t i_minus_w;
+        std::vector <index_t> _row, _col;
+        std::vector <weight_t> _c, _d, _p, _w;
+        // Position of each input edge within the above
+        std::vector <index_t> _edge_pos;
+        index_t _dest;
+
+        rsp_solver_t _solver;
+        Eigen::SparseLU <sp_mat_col_t, Eigen::COLAMDOrdering <int> > _lu;
+        bool _analysed;
+        // Iterative solvers need (I - W)' explicitly, with one solver each
+        sp_mat_col_t i_minus_w_t;
+        Eigen::BiCGSTAB <sp_mat_col_t, Eigen::IncompleteLUT <double> >
+            _ilut, _ilut_t;
+        Eigen::BiCGSTAB <sp_mat_col_t, Eigen::DiagonalPreconditioner <double> >
+            _jacobi, _jacobi_t;
+        // Solutions are retained, and used as initial guesses for the
+        // iterative solvers if _warm_start.
+        bool _warm_start;
+        Eigen::VectorXd _z1, _zn, _e;
+        // zn depends only on W and dest, so is shared between all starts
+        bool _zn_current;
+
+        void solve_dest ();
+        // Results from _z1 and _zn
+        void edge_results (index_t start, rsp_result_t &result);
+
+        template <typename S>
+        void solve_iterative (S &solver, const Eigen::VectorXd &b,
+                Eigen::VectorXd &x);
+
+    public:
+        // Timings of factorisations and solves, and counts of BiCGSTAB
+        // iterations
+        Instrument instrument;
+
+        /* from and to are dense vertex indices in [0, nv), c are the
+         * (weighted) costs which determine transition probabilities, and d
+         * the distances which are summed to the expected distance. */
+        GraphRSP (index_t nv, const std::vector <index_t> &from,
+                const std::vector <index_t> &to,
+                const std::vector <weight_t> &c,
+                const std::vector <weight_t> &d);
+
+        // tol is ignored by rsp_direct
+        void set_solver (rsp_solver_t solver, double tol = 1.0e-10);
+        /* Initial guesses for the two solution vectors (each of length nv,
+         * and as from z1 () and zn ()) for the next iterative solve, and all
+         * subsequent ones, which start from the previous solution. */
+        void set_guess (const Eigen::VectorXd &z1, const Eigen::VectorXd &zn);
+        // Start the next iterative solve from zero
+        void clear_guess () { _warm_start = false; }
+        const Eigen::VectorXd &z1 () const { return _z1; }
+        const Eigen::VectorXd &zn () const { return _zn; }
+
+        // Fill W = exp (-eta c) * P, with the row of dest set to zero
+        void set_weights (double eta, index_t dest);
+        // Factorise (I - W), or compute its preconditioners; throws on failure
+        void factorise ();
+        // Densities, probabilities and distance for paths from start to dest
+        void solve (index_t start, rsp_result_t &result);
+        // As above, for several starts to the same dest
+        void solve (const std::vector <index_t> &starts,
+                std::vector <rsp_result_t> &results);
+};
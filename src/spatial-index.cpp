@@ -0,0 +1,359 @@
+/***************************************************************************
+ *  Project:    osmprob
+ *  File:       spatial-index.cpp
+ *  Language:   C++
+ *
+ *  osmprob is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  osmprob is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  osm-router.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Snapping of coordinates to their nearest graph vertices,
+ *                  through an index which may be built once for each graph.
+ *
+ *  Limitations:
+ *
+ *  Dependencies:       OpenMP (optional)
+ *
+ *  Compiler Options:   -std=c++11 $(SHLIB_OPENMP_CXXFLAGS)
+ ***************************************************************************/
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+
+#include <Rcpp.h>
+
+#include "spatial-index.h"
+#include "dijkstra.h" // for no_vertex
+#include "parallel.h"
+
+// Ranges no larger than this are searched exhaustively
+const size_t kd_leaf_size = 8;
+
+inline void unit_vector (double lon, double lat, double *v)
+{
+    const double deg = M_PI / 180.0;
+    const double cl = std::cos (lat * deg);
+    v [0] = cl * std::cos (lon * deg);
+    v [1] = cl * std::sin (lon * deg);
+    v [2] = std::sin (lat * deg);
+}
+
+inline double dist2 (const double *a, const double *b)
+{
+    const double dx = a [0] - b [0], dy = a [1] - b [1], dz = a [2] - b [2];
+    return dx * dx + dy * dy + dz * dz;
+}
+
+SphereKdTree::SphereKdTree (const std::vector <double> &lon,
+        const std::vector <double> &lat)
+{
+    const size_t n = lon.size ();
+    std::vector <double> pts (3 * n);
+    for (size_t i = 0; i < n; i++)
+        unit_vector (lon [i], lat [i], &pts [3 * i]);
+
+    order.resize (n);
+    for (size_t i = 0; i < n; i++)
+        order [i] = i;
+    axis.assign (n, 0);
+    xyz.swap (pts);
+    build (0, n);
+
+    // Permute the coordinates into tree order, so that searches run over
+    // contiguous memory
+    std::vector <double> sorted (3 * n);
+    for (size_t i = 0; i < n; i++)
+        std::copy (&xyz [3 * order [i]], &xyz [3 * order [i]] + 3,
+                &sorted [3 * i]);
+    xyz.swap (sorted);
+}
+
+// While building, xyz is in input order and only order is permuted
+void SphereKdTree::build (size_t lo, size_t hi)
+{
+    if (hi - lo <= kd_leaf_size)
+        return;
+
+    // Split on the axis of greatest extent
+    double lower [3], upper [3];
+    for (int a = 0; a < 3; a++)
+    {
+        lower [a] = std::numeric_limits <double>::infinity ();
+        upper [a] = -lower [a];
+    }
+    for (size_t i = lo; i < hi; i++)
+        for (int a = 0; a < 3; a++)
+        {
+            lower [a] = std::min (lower [a], xyz [3 * order [i] + a]);
+            upper [a] = std::max (upper [a], xyz [3 * order [i] + a]);
+        }
+    unsigned char ax = 0;
+    for (unsigned char a = 1; a < 3; a++)
+        if (upper [a] - lower [a] > upper [ax] - lower [ax])
+            ax = a;
+
+    const size_t mid = lo + (hi - lo) / 2;
+    std::nth_element (order.begin () + lo, order.begin () + mid,
+            order.begin () + hi, [this, ax] (index_t i, index_t j) {
+                return xyz [3 * i + ax] < xyz [3 * j + ax]; });
+    axis [mid] = ax;
+    build (lo, mid);
+    build (mid + 1, hi);
+}
+
+void SphereKdTree::nearest (size_t lo, size_t hi, const double *q,
+        const char *mask, index_t &best, double &best_d2) const
+{
+    if (hi - lo <= kd_leaf_size)
+    {
+        for (size_t i = lo; i < hi; i++)
+        {
+            if (mask && !mask [order [i]])
+                continue;
+            const double d2 = dist2 (q, &xyz [3 * i]);
+            if (d2 < best_d2)
+            {
+                best_d2 = d2;
+                best = i;
+            }
+        }
+        return;
+    }
+
+    const size_t mid = lo + (hi - lo) / 2;
+    const double d2 = dist2 (q, &xyz [3 * mid]);
+    if (d2 < best_d2 && !(mask && !mask [order [mid]]))
+    {
+        best_d2 = d2;
+        best = mid;
+    }
+
+    // Nearer side first; the further side only if the splitting plane is
+    // closer than the best point so far
+    const double diff = q [axis [mid]] - xyz [3 * mid + axis [mid]];
+    if (diff < 0.0)
+    {
+        nearest (lo, mid, q, mask, best, best_d2);
+        if (diff * diff < best_d2)
+            nearest (mid + 1, hi, q, mask, best, best_d2);
+    } else
+    {
+        nearest (mid + 1, hi, q, mask, best, best_d2);
+        if (diff * diff < best_d2)
+            nearest (lo, mid, q, mask, best, best_d2);
+    }
+}
+
+index_t SphereKdTree::nearest (double lon, double lat, double &chord,
+        const char *mask) const
+{
+    double q [3];
+    unit_vector (lon, lat, q);
+    index_t best = no_vertex;
+    double best_d2 = std::numeric_limits <double>::infinity ();
+    nearest (0, order.size (), q, mask, best, best_d2);
+    chord = std::sqrt (best_d2);
+    return best == no_vertex ? no_vertex : order [best];
+}
+
+index_t nearest_by_scan (const std::vector <double> &lon,
+        const std::vector <double> &lat, double qlon, double qlat,
+        const char *mask)
+{
+    double q [3], p [3];
+    unit_vector (qlon, qlat, q);
+    index_t best = no_vertex;
+    double best_d2 = std::numeric_limits <double>::infinity ();
+    for (index_t i = 0; i < lon.size (); i++)
+    {
+        if (mask && !mask [i])
+            continue;
+        unit_vector (lon [i], lat [i], p);
+        const double d2 = dist2 (q, p);
+        if (d2 < best_d2)
+        {
+            best_d2 = d2;
+            best = i;
+        }
+    }
+    return best;
+}
+
+/* The vertices of a compact graph, each once, for snapping points to the
+ * graph. IDs are held as the CHARSXPs of the input, which R shares between all
+ * equal strings, so vertices are interned without copying any strings. */
+struct vertex_index_t
+{
+    Rcpp::CharacterVector ids;
+    std::vector <double> lon, lat;
+    // Whether each vertex has out-going or incoming edges
+    std::vector <char> has_out, has_in;
+    std::unique_ptr <SphereKdTree> tree;
+
+    vertex_index_t (Rcpp::DataFrame netdf);
+
+    void build_tree ()
+    {
+        tree.reset (new SphereKdTree (lon, lat));
+    }
+
+    Rcpp::CharacterVector nearest (const std::vector <double> &qlon,
+            const std::vector <double> &qlat, const std::string &vertices);
+};
+
+vertex_index_t::vertex_index_t (Rcpp::DataFrame netdf)
+{
+    Rcpp::CharacterVector from = netdf ["from_id"], to = netdf ["to_id"];
+    Rcpp::NumericVector from_lon = netdf ["from_lon"],
+        from_lat = netdf ["from_lat"], to_lon = netdf ["to_lon"],
+        to_lat = netdf ["to_lat"];
+
+    std::unordered_map <SEXP, index_t> index;
+    std::vector <SEXP> names;
+    auto vertex = [&] (SEXP id, double x, double y) {
+        auto it = index.emplace (id, static_cast <index_t> (names.size ()));
+        if (it.second)
+        {
+            names.push_back (id);
+            lon.push_back (x);
+            lat.push_back (y);
+            has_out.push_back (0);
+            has_in.push_back (0);
+        }
+        return it.first->second;
+    };
+    for (int i = 0; i < from.size (); i++)
+    {
+        has_out [vertex (STRING_ELT (from, i), from_lon [i], from_lat [i])] = 1;
+        has_in [vertex (STRING_ELT (to, i), to_lon [i], to_lat [i])] = 1;
+    }
+
+    ids = Rcpp::CharacterVector (names.size ());
+    for (size_t v = 0; v < names.size (); v++)
+        SET_STRING_ELT (ids, v, names [v]);
+}
+
+Rcpp::CharacterVector vertex_index_t::nearest (
+        const std::vector <double> &qlon, const std::vector <double> &qlat,
+        const std::string &vertices)
+{
+    if (qlon.size () != qlat.size ())
+        throw std::runtime_error ("longitudes and latitudes must have the "
+                "same lengths");
+    if (lon.empty ())
+        throw std::runtime_error ("there are no vertices to snap to");
+    const char *mask = nullptr;
+    if (vertices == "from")
+        mask = &has_out [0];
+    else if (vertices == "to")
+        mask = &has_in [0];
+    else if (vertices != "all")
+        throw std::runtime_error ("vertices must be one of all, from or to");
+
+    // Building the tree costs about as much as log2 (n) exhaustive searches
+    const size_t nq = qlon.size ();
+    if (!tree && nq > std::log2 (static_cast <double> (lon.size ())))
+        build_tree ();
+
+    std::vector <index_t> nearest (nq);
+    parallel_for (nq, [&] (size_t i, int)
+    {
+        double chord;
+        nearest [i] = tree ? tree->nearest (qlon [i], qlat [i], chord, mask) :
+            nearest_by_scan (lon, lat, qlon [i], qlat [i], mask);
+    });
+
+    Rcpp::CharacterVector res (nq);
+    for (size_t i = 0; i < nq; i++)
+        SET_STRING_ELT (res, i, nearest [i] == no_vertex ? NA_STRING :
+                STRING_ELT (ids, nearest [i]));
+    return res;
+}
+
+vertex_index_t &vertex_index (SEXP index)
+{
+    Rcpp::XPtr <vertex_index_t> p (index);
+    if (p.get () == NULL)
+        throw std::runtime_error ("vertex index is no longer valid; "
+                "it must be rebuilt in each R session");
+    return *p;
+}
+
+//' rcpp_vertex_index
+//'
+//' Spatial index of the vertices of a compact graph
+//'
+//' @param netdf A \code{data.frame} with character columns \code{from_id} and
+//' \code{to_id}, and numeric columns \code{from_lon}, \code{from_lat},
+//' \code{to_lon} and \code{to_lat}
+//'
+//' @return External pointer to the index
+//'
+//' @noRd
+// [[Rcpp::export]]
+SEXP rcpp_vertex_index (Rcpp::DataFrame netdf)
+{
+    Rcpp::XPtr <vertex_index_t> p (new vertex_index_t (netdf), true);
+    p->build_tree ();
+    return p;
+}
+
+//' rcpp_index_nearest
+//'
+//' Nearest vertices of an indexed graph to a set of points, by great circle
+//' distance
+//'
+//' @param index External pointer returned from \code{rcpp_vertex_index}
+//' @param qlon Longitudes of points to be snapped to vertices
+//' @param qlat Latitudes of points to be snapped to vertices
+//' @param vertices Vertices to snap to: "all", "from", those with out-going
+//' edges, or "to", those with incoming edges
+//'
+//' @return ID of the nearest vertex to each point, or \code{NA} for points with
+//' missing coordinates
+//'
+//' @noRd
+// [[Rcpp::export]]
+Rcpp::CharacterVector rcpp_index_nearest (SEXP index,
+        std::vector <double> qlon, std::vector <double> qlat,
+        std::string vertices = "all")
+{
+    return vertex_index (index).nearest (qlon, qlat, vertices);
+}
+
+//' rcpp_graph_nearest
+//'
+//' Nearest vertices of a graph to a set of points, by great circle distance,
+//' without a prior index. A k-d tree is built only if there are enough points
+//' to repay its construction, and otherwise all vertices are searched.
+//'
+//' @inheritParams rcpp_vertex_index
+//' @inheritParams rcpp_index_nearest
+//'
+//' @return ID of the nearest vertex to each point, or \code{NA} for points with
+//' missing coordinates
+//'
+//' @noRd
+// [[Rcpp::export]]
+Rcpp::CharacterVector rcpp_graph_nearest (Rcpp::DataFrame netdf,
+        std::vector <double> qlon, std::vector <double> qlat,
+        std::string vertices = "all")
+{
+    vertex_index_t index (netdf);
+    return index.nearest (qlon, qlat, vertices);
+}
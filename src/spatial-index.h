@@ -0,0 +1,73 @@
+/***************************************************************************
+ *  Project:    osmprob
+ *  File:       spatial-index.h
+ *  Language:   C++
+ *
+ *  osmprob is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  osmprob is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  osm-router.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    k-d tree for nearest vertex queries on the sphere. Points
+ *                  are held as 3-D unit vectors, for which straight-line
+ *                  (chord) distance increases strictly with great circle
+ *                  distance, so nearest neighbours in the tree are exactly
+ *                  the geodesic nearest neighbours, with no special cases at
+ *                  the poles or the antimeridian.
+ *
+ *  Limitations:    Static; points can not be added after building. Building
+ *                  takes O(n log n) time, so for a handful of queries an
+ *                  exhaustive search, with nearest_by_scan, is faster.
+ *
+ *  Dependencies:       none (no Rcpp, so usable from threaded code)
+ *
+ *  Compiler Options:   -std=c++11
+ ***************************************************************************/
+
+#pragma once
+
+#include <vector>
+
+#include "graph-csr.h"
+
+class SphereKdTree
+{
+    private:
+        // Points in tree order, 3 coordinates each, with their input index.
+        // The node of range [lo, hi) is its midpoint, split on axis [mid].
+        std::vector <double> xyz;
+        std::vector <index_t> order;
+        std::vector <unsigned char> axis;
+
+        void build (size_t lo, size_t hi);
+        void nearest (size_t lo, size_t hi, const double *q, const char *mask,
+                index_t &best, double &best_d2) const;
+
+    public:
+        SphereKdTree (const std::vector <double> &lon,
+                const std::vector <double> &lat);
+
+        size_t size () const { return order.size (); }
+
+        /* Index of the input point nearest to (lon, lat), and the chord
+         * distance between them on the unit sphere; no_vertex if empty. If
+         * mask is given, only input points i with mask [i] are considered. */
+        index_t nearest (double lon, double lat, double &chord,
+                const char *mask = nullptr) const;
+};
+
+// Nearest of all n points by exhaustive search, as for SphereKdTree::nearest
+index_t nearest_by_scan (const std::vector <double> &lon,
+        const std::vector <double> &lat, double qlon, double qlat,
+        const char *mask = nullptr);